@@ -6,6 +6,7 @@
 #define USE_CACHE_VERIFICATION_MAP 0
 #define PRINT_BOARD_STATE 0
 #define PRINT_CACHE_STATS 0
+#define PRINT_SEARCH_STATS 0
 
 #include <GLFW/glfw3.h>
 
@@ -18,8 +19,10 @@
 #include <cstdio>
 #include <cstdlib>
 #include <climits>
+#include <cfloat>
 #include <cassert>
 #include <stdint.h>
+#include <time.h>
 
 template <typename T>
 static T min(T a, T b) { return (a < b ? a : b); }
@@ -33,6 +36,20 @@ static T clamp(T x, T a, T b) { return (x < a ? a : (x > b ? b : x)); }
 template <typename T>
 static T signum(T a) { return T(T(0) < a) - T(a < T(0)); }
 
+// monotonic wall-clock time in seconds (unlike glfwGetTime, this works without a window)
+static double get_time() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+// CPU time used by the calling thread, in seconds
+static double get_thread_time() {
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
 enum BoardConfig {
 	TILES_X = 4,
 	TILES_Y = 4,
@@ -338,6 +355,12 @@ struct Board {
 		return (count_free() == 0 && !has_direct_matches());
 	}
 
+	bool can_move(int dir) const {
+		assert(dir >= 0 && dir < 4);
+		Board next_state = *this;
+		return next_state.tilt(DIR_DX[dir], DIR_DY[dir]);
+	}
+
 	void place(int count, AnimState *anim, RNG &rng) {
 		assert(count > 0);
 		uint8_t free[NUM_TILES];
@@ -429,6 +452,21 @@ struct Board {
 		if (moved) { place(1, anim, rng); }
 		return moved;
 	}
+
+	// make/unmake: searchers place tiles in one board and take them away again, rather than
+	// placing each in a fresh copy of the board; a placement is undone by emptying its cell, so
+	// the cell is the whole undo record. (There's no make/unmake for moves: a tilt can rewrite
+	// every tile, so recording enough to undo it costs as much as copying the board.)
+	void make_placement(int where, int value) {
+		assert(where >= 0 && where < NUM_TILES);
+		assert(state[where] == 0);
+		state[where] = value;
+	}
+
+	void unmake_placement(int where) {
+		assert(where >= 0 && where < NUM_TILES);
+		state[where] = 0;
+	}
 };
 
 struct BoardHistory {
@@ -543,7 +581,6 @@ static uint64_t pack_board_state(const Board &board) {
 	return k;
 }
 
-#if 0 // unused
 static void unpack_board_state(Board &board, const uint64_t state) {
 	assert(NUM_TILES == 16);
 	uint64_t k = state;
@@ -552,7 +589,6 @@ static void unpack_board_state(Board &board, const uint64_t state) {
 		k >>= 4;
 	}
 }
-#endif
 
 static uint64_t mix64(uint64_t key) {
 	// from: https://gist.github.com/badboy/6267743
@@ -575,10 +611,10 @@ void print_blob(const T &v) {
 }
 #endif
 
-template <typename T>
+template <typename T, int SIZE_LOG2 = 15>
 class BoardCache {
 		enum {
-			ENTRY_COUNT = (1 << 15),
+			ENTRY_COUNT = (1 << SIZE_LOG2),
 			BUCKET_SIZE = 8,
 			BUCKET_COUNT = ENTRY_COUNT / BUCKET_SIZE,
 			BUCKET_INDEX_MASK = (BUCKET_COUNT - 1)
@@ -709,48 +745,553 @@ class BoardCache {
 #endif
 };
 
-typedef int (*Evaluator)(const Board &board);
+// Thread-safe variant of BoardCache, for sharing one large table between search threads.
+// Each bucket is guarded by its own spin lock, and values are copied out rather than returned
+// by pointer (since another thread may overwrite the entry at any time).
+template <typename T, int SIZE_LOG2 = 20>
+class SharedBoardCache {
+		enum {
+			ENTRY_COUNT = (1 << SIZE_LOG2),
+			BUCKET_SIZE = 8,
+			BUCKET_COUNT = ENTRY_COUNT / BUCKET_SIZE,
+			BUCKET_INDEX_MASK = (BUCKET_COUNT - 1)
+		};
+		struct Bucket {
+			mint_atomic32_t lock;
+			uint64_t keys[BUCKET_SIZE];
+			T values[BUCKET_SIZE];
+		};
+
+		static void lock_bucket(Bucket &bucket) {
+			while (mint_compare_exchange_strong_32_relaxed(&bucket.lock, 0, 1) != 0) {
+				while (mint_load_32_relaxed(&bucket.lock) != 0) {}
+			}
+			mint_thread_fence_acquire();
+		}
+
+		static void unlock_bucket(Bucket &bucket) {
+			mint_thread_fence_release();
+			mint_store_32_relaxed(&bucket.lock, 0);
+		}
+
+		Bucket &bucket_for(const uint64_t k) const {
+			return m_buckets[mix64(k) & BUCKET_INDEX_MASK];
+		}
+
+	public:
+		SharedBoardCache(): m_buckets(0) {
+			m_buckets = static_cast<Bucket*>(calloc(BUCKET_COUNT, sizeof(Bucket)));
+		}
+
+		~SharedBoardCache() {
+			free(m_buckets);
+		}
+
+		// not thread-safe: only call this while no searches are using the cache
+		void reset() {
+			memset(m_buckets, 0, BUCKET_COUNT * sizeof(Bucket));
+		}
+
+		bool get(const uint64_t k, T &value) const {
+			assert(k);
+			Bucket &bucket = bucket_for(k);
+			bool found = false;
+			lock_bucket(bucket);
+			for (int i = 0; i < BUCKET_SIZE; ++i) {
+				if (bucket.keys[i] == k) {
+					value = bucket.values[i];
+					found = true;
+					break;
+				}
+			}
+			unlock_bucket(bucket);
+			return found;
+		}
+
+		void put(const uint64_t k, const T &value) {
+			assert(k);
+			Bucket &bucket = bucket_for(k);
+			lock_bucket(bucket);
+			int i;
+			for (i = 0; i < BUCKET_SIZE - 1; ++i) {
+				if (bucket.keys[i] == k) { break; }
+			}
+			// move to front (dropping the last entry if the key wasn't already present)
+			for (; i > 0; --i) {
+				bucket.keys[i] = bucket.keys[i-1];
+				bucket.values[i] = bucket.values[i-1];
+			}
+			bucket.keys[0] = k;
+			bucket.values[0] = value;
+			unlock_bucket(bucket);
+		}
+
+	private:
+		Bucket *m_buckets;
+};
+
+// Two-level cache: a private BoardCache for shallow results, layered in front of an (optional)
+// SharedBoardCache for deep results. Shallow entries are cheap to recompute and are hit very
+// often, so keeping them thread-local stops search threads fighting over their cache lines;
+// deep entries are expensive and worth the cost of publishing to every thread.
+template <typename T>
+class TieredBoardCache {
+	public:
+		typedef SharedBoardCache<T> SharedCache;
+
+		TieredBoardCache(): m_shared(0), m_publish_lookahead(INT_MAX) {}
+
+		// results with lookahead >= publish_lookahead will be stored in (and fetched from) shared
+		void share(SharedCache *shared, int publish_lookahead) {
+			m_shared = shared;
+			m_publish_lookahead = (shared ? publish_lookahead : INT_MAX);
+		}
+
+		// only resets the private level; the shared level belongs to whoever set it up
+		void reset() { m_local.reset(); }
+
+		void *where(const uint64_t k) { return m_local.where(k); }
+
+		const T *get(const uint64_t k, const void *where, int lookahead) {
+			if (lookahead < m_publish_lookahead) { return m_local.get(k, where); }
+			return (m_shared->get(k, m_fetched) ? &m_fetched : 0);
+		}
+
+		void put(const uint64_t k, void *where, int lookahead, const T &value) {
+			if (lookahead < m_publish_lookahead) {
+				m_local.put(k, where, value);
+			} else {
+				m_shared->put(k, value);
+			}
+		}
+
+	private:
+		BoardCache<T> m_local;
+		SharedCache *m_shared;
+		int m_publish_lookahead;
+		T m_fetched;
+};
+
+// Direct-mapped cache of leaf evaluations, kept separate from the search caches so that
+// the (very numerous) leaf entries can't evict the (much more expensive) interior entries
+class EvalCache {
+		enum {
+			ENTRY_COUNT = (1 << 16),
+			ENTRY_INDEX_MASK = (ENTRY_COUNT - 1)
+		};
+		struct Entry {
+			uint64_t key;
+			int score;
+		};
+
+	public:
+		EvalCache(): m_entries(0) {
+			m_entries = static_cast<Entry*>(calloc(ENTRY_COUNT, sizeof(Entry)));
+		}
+
+		~EvalCache() {
+			free(m_entries);
+		}
+
+		void reset() {
+			memset(m_entries, 0, ENTRY_COUNT * sizeof(Entry));
+		}
+
+		bool get(const uint64_t k, int &score) const {
+			assert(k);
+			const Entry &entry = m_entries[mix64(k) & ENTRY_INDEX_MASK];
+			if (entry.key == k) {
+				score = entry.score;
+				return true;
+			}
+			return false;
+		}
+
+		void put(const uint64_t k, const int score) {
+			assert(k);
+			Entry &entry = m_entries[mix64(k) & ENTRY_INDEX_MASK];
+			entry.key = k;
+			entry.score = score;
+		}
+
+	private:
+		Entry *m_entries;
+};
+
+// Work-stealing task scheduler for searches that split their work over several threads.
+// Each thread has its own deque of tasks: it pushes and pops its own tasks at the bottom (so it
+// works depth-first, like a serial search), and when it runs out, it steals from the top of
+// another thread's deque (taking the oldest, and so probably the biggest, tasks).
+// Thread 0 is the thread that starts the search; the other threads are helpers that call work()
+// until the search ends. Tasks must not outlive the stack frame that spawned them, so every
+// spawn() must be matched by a wait() on the same pending counter.
+class WorkStealingScheduler {
+	public:
+		typedef void (*TaskFn)(void *data, int thread);
+
+		explicit WorkStealingScheduler(int num_threads): m_num_threads(num_threads), m_deques(0) {
+			assert(num_threads >= 1);
+			m_deques = new Deque[num_threads];
+			m_done._nonatomic = 0;
+			m_num_steals._nonatomic = 0;
+		}
+
+		~WorkStealingScheduler() {
+			delete[] m_deques;
+		}
+
+		int get_num_threads() const { return m_num_threads; }
+
+		// number of tasks run by a thread other than the one that spawned them, since begin()
+		int get_num_steals() const { return (int)m_num_steals._nonatomic; }
+
+		// not thread-safe: call these before starting the helpers, and after they've all stopped
+		void begin() {
+			for (int i = 0; i < m_num_threads; ++i) { m_deques[i].top = m_deques[i].bottom = 0; }
+			m_done._nonatomic = 0;
+			m_num_steals._nonatomic = 0;
+		}
+
+		// tells the helpers to return from work()
+		void end() {
+			mint_thread_fence_release();
+			mint_store_32_relaxed(&m_done, 1);
+		}
+
+		// queues fn(data) to be run by any thread; *pending is incremented now, and decremented
+		// when the task has finished; if the deque is full the task is run immediately instead
+		void spawn(int thread, TaskFn fn, void *data, mint_atomic32_t *pending) {
+			const Task task = { fn, data, pending };
+			mint_fetch_add_32_relaxed(pending, 1);
+			if (!m_deques[thread].push(task)) { run(task, thread); }
+		}
+
+		// runs tasks until *pending drops to zero
+		void wait(int thread, mint_atomic32_t *pending) {
+			while (mint_load_32_relaxed(pending) != 0) {
+				if (!run_one(thread)) { tthread::this_thread::yield(); }
+			}
+			mint_thread_fence_acquire();
+		}
+
+		// the main loop for helper threads: runs tasks until end() is called
+		void work(int thread) {
+			assert(thread > 0 && thread < m_num_threads);
+			while (mint_load_32_relaxed(&m_done) == 0) {
+				if (!run_one(thread)) { tthread::this_thread::yield(); }
+			}
+		}
+
+	private:
+		enum {
+			DEQUE_CAPACITY = 1024,
+			DEQUE_INDEX_MASK = (DEQUE_CAPACITY - 1)
+		};
+		struct Task {
+			TaskFn fn;
+			void *data;
+			mint_atomic32_t *pending;
+		};
+		// a spin lock is good enough here: each operation only holds it for a few instructions
+		struct Deque {
+			mint_atomic32_t lock;
+			int top;
+			int bottom;
+			Task tasks[DEQUE_CAPACITY];
+
+			Deque(): top(0), bottom(0) { lock._nonatomic = 0; }
+
+			void acquire() {
+				while (mint_compare_exchange_strong_32_relaxed(&lock, 0, 1) != 0) {
+					while (mint_load_32_relaxed(&lock) != 0) {}
+				}
+				mint_thread_fence_acquire();
+			}
+
+			void release() {
+				mint_thread_fence_release();
+				mint_store_32_relaxed(&lock, 0);
+			}
+
+			bool push(const Task &task) {
+				acquire();
+				const bool ok = (bottom - top < DEQUE_CAPACITY);
+				if (ok) { tasks[bottom++ & DEQUE_INDEX_MASK] = task; }
+				release();
+				return ok;
+			}
+
+			// pop from the bottom (for the owner) or steal from the top (for other threads)
+			bool take(Task &task, bool steal) {
+				acquire();
+				const bool ok = (bottom != top);
+				if (ok) { task = (steal ? tasks[top++ & DEQUE_INDEX_MASK] : tasks[--bottom & DEQUE_INDEX_MASK]); }
+				if (top == bottom) { top = bottom = 0; }
+				release();
+				return ok;
+			}
+		};
+
+		int m_num_threads;
+		Deque *m_deques;
+		mint_atomic32_t m_done;
+		mint_atomic32_t m_num_steals;
+
+		void run(const Task &task, int thread) {
+			task.fn(task.data, thread);
+			mint_thread_fence_release();
+			mint_fetch_add_32_relaxed(task.pending, -1);
+		}
+
+		bool run_one(int thread) {
+			Task task;
+			if (m_deques[thread].take(task, false)) {
+				run(task, thread);
+				return true;
+			}
+			for (int i = 1; i < m_num_threads; ++i) {
+				const int victim = (thread + i) % m_num_threads;
+				if (m_deques[victim].take(task, true)) {
+					mint_fetch_add_32_relaxed(&m_num_steals, 1);
+					run(task, thread);
+					return true;
+				}
+			}
+			return false;
+		}
+};
+
+typedef int (*EvalFn)(const Board &board);
+
+// A board scoring function, plus the range its scores are guaranteed to fall in
+// (some searchers can prune using the range; the default range is unbounded)
+struct Evaluator {
+	EvalFn fn;
+	int min_score;
+	int max_score;
+
+	Evaluator(EvalFn fn = 0, int min_score = INT_MIN, int max_score = INT_MAX):
+		fn(fn), min_score(min_score), max_score(max_score) {
+		assert(min_score <= max_score);
+	}
+
+	int operator()(const Board &board) const {
+		const int score = fn(board);
+		assert(score >= min_score && score <= max_score);
+		return score;
+	}
+};
 
 class Searcher {
 	public:
-		Searcher(): evalfn(0), num_moves(0), best_first_move(-1) {
+		Searcher():
+			num_moves(0), num_evals(0), num_eval_hits(0), best_first_move(-1),
+			completed_lookahead(0), deadline(0.0), poll_count(0), timed_out(false), m_master(0), m_stop(0) {
 			m_cancelled._nonatomic = 0;
 		}
 
+		virtual ~Searcher() {}
+
+		// for searchers working on behalf of another searcher: cancelling the master cancels
+		// this searcher too, and this searcher's searches share the master's deadline
+		void set_master(const Searcher *master) { m_master = master; }
+
+		// for searchers racing other searchers: searches stop as soon as *stop becomes non-zero
+		void set_stop_flag(mint_atomic32_t *stop) { m_stop = stop; }
+
 		void cancel() {
 			mint_store_32_relaxed(&m_cancelled, 1);
 		}
 
-		int search(Evaluator evalfn, const Board &board, const RNG &rng, int lookahead) {
-			assert(evalfn);
-			this->evalfn = evalfn;
-			this->num_moves = 0;
-			this->best_first_move = -1;
-			this->m_cancelled._nonatomic = 0;
+		// searches are anytime: if a search is cancelled (or runs out of time), it returns INT_MIN,
+		// but get_best_first_move() still gives the best move among the first moves whose subtrees
+		// were searched completely before it stopped (or -1 if there weren't any), and
+		// get_completed_lookahead() is 0
+		int search(const Evaluator &evalfn, const Board &board, const RNG &rng, int lookahead) {
+			prepare(evalfn);
+			begin_search(evalfn, 0.0);
 			int move;
 			int score = do_search(board, rng, lookahead, &move);
+			end_search(move, lookahead);
 			if (this->m_cancelled._nonatomic) { return INT_MIN; }
-			this->best_first_move = move;
 			return score;
 		}
 
+		// iterative deepening: search with lookahead 1, 2, 3, ... until max_lookahead is reached
+		// or time_budget (in seconds) runs out, and return the result of the deepest search that
+		// finished. Cancelling the search stops it the same way running out of time does. If no
+		// search finished, the move is the best found by the first one before it was stopped (and
+		// the score is INT_MIN); otherwise the search that was stopped is abandoned.
+		int search_timed(const Evaluator &evalfn, const Board &board, const RNG &rng, int max_lookahead, double time_budget) {
+			assert(max_lookahead >= 1);
+			assert(time_budget > 0.0);
+			prepare(evalfn);
+			const double start_time = get_time();
+			begin_search(evalfn, start_time + time_budget);
+			int best_score = INT_MIN;
+			for (int lookahead = 1; lookahead <= max_lookahead; ++lookahead) {
+				const double iteration_start = get_time();
+				int move;
+				int score = do_search(board, rng, lookahead, &move);
+				if (this->m_cancelled._nonatomic) {
+					if (lookahead == 1) { this->best_first_move = move; }
+					break;
+				}
+				// a search that proves every move loses may not pick one; keep the last one picked
+				if (move >= 0 || this->best_first_move < 0) { this->best_first_move = move; }
+				this->completed_lookahead = lookahead;
+				best_score = score;
+				if (board.finished()) { break; } // no legal moves; searching deeper won't change that
+
+				// don't start an iteration that almost certainly won't finish in time
+				const double now = get_time();
+				if (now + (now - iteration_start) * ITERATION_GROWTH_ESTIMATE > this->deadline) { break; }
+			}
+			end_search();
+			return best_score;
+		}
+
+		// score the position after a move has been made, but before the new tile has been placed
+		// (lookahead counts the move that has already been made); the score isn't rounded to an
+		// int, so that afterstate scores from searchers with fractional scores can be compared
+		double search_afterstate(const Evaluator &evalfn, const Board &board, const RNG &rng, int lookahead) {
+			assert(lookahead >= 1);
+			prepare(evalfn);
+			begin_search(evalfn, 0.0);
+			double score = do_search_afterstate(board, rng, lookahead);
+			end_search();
+			if (this->m_cancelled._nonatomic) { return (double)INT_MIN; }
+			this->completed_lookahead = lookahead;
+			return score;
+		}
+
+		// does any setup for searching with evalfn that shouldn't be charged to a search's time
+		// budget (eg, clearing caches that were filled using a different evaluator); the searches
+		// do this themselves before they start the clock, so calling it is never required
+		void prepare(const Evaluator &evalfn) {
+			assert(evalfn.fn);
+			// cached evaluations are only valid for the evaluator that produced them
+			if (evalfn.fn != this->evalfn.fn) {
+				eval_cache.reset();
+				this->evalfn = evalfn;
+			}
+			do_prepare(evalfn);
+		}
+
 		int get_num_moves() const { return num_moves; }
+		int get_num_evals() const { return num_evals; }
+		int get_num_eval_hits() const { return num_eval_hits; }
 		int get_best_first_move() const { return best_first_move; }
+		int get_completed_lookahead() const { return completed_lookahead; }
 
 	protected:
-		int eval_board(const Board &board) { return evalfn(board); }
+		int eval_board(const Board &board) { return eval_board(board, pack_board_state(board)); }
+
+		int eval_board(const Board &board, const uint64_t board_k) {
+			int score;
+			++num_evals;
+			if (eval_cache.get(board_k, score)) {
+				++num_eval_hits;
+				return score;
+			}
+			score = evalfn(board);
+			eval_cache.put(board_k, score);
+			return score;
+		}
+
+		const Evaluator &evaluator() const { return evalfn; }
+		int eval_min_score() const { return evalfn.min_score; }
+		int eval_max_score() const { return evalfn.max_score; }
+
 		void tally_move() { ++num_moves; }
-		bool cancelled() { return (mint_load_32_relaxed(&m_cancelled) != 0); }
+		void tally_moves(int n) { num_moves += n; }
+
+		// a worker that ran out of time means this search is out of time too
+		void merge_timeout(const Searcher &worker) {
+			if (worker.timed_out) {
+				timed_out = true;
+				mint_store_32_relaxed(&m_cancelled, 1);
+			}
+		}
+
+		void begin_search(const Evaluator &evalfn, double deadline) {
+			assert(evalfn.fn);
+			// cached evaluations are only valid for the evaluator that produced them
+			if (evalfn.fn != this->evalfn.fn) { eval_cache.reset(); }
+			this->evalfn = evalfn;
+			this->num_moves = 0;
+			this->num_evals = 0;
+			this->num_eval_hits = 0;
+			this->best_first_move = -1;
+			this->completed_lookahead = 0;
+			this->deadline = (m_master ? m_master->deadline : deadline);
+			this->poll_count = 0;
+			this->timed_out = false;
+			this->m_cancelled._nonatomic = 0;
+		}
+
+		void end_search() {
+#if PRINT_CACHE_STATS
+			printf("(eval-cache) hits %d of %d evaluations\n", num_eval_hits, num_evals);
+#endif
+		}
+
+		// records the result of a search to the given lookahead, the way search() does
+		// (for searches that aren't run by search())
+		void end_search(int move, int lookahead) {
+			end_search();
+			this->best_first_move = move;
+			if (!this->m_cancelled._nonatomic) { this->completed_lookahead = lookahead; }
+		}
+
+		bool cancelled() {
+			if (mint_load_32_relaxed(&m_cancelled) != 0) { return true; }
+			// being stopped from outside cancels this search too, so it isn't taken as finished
+			if ((m_master && mint_load_32_relaxed(&m_master->m_cancelled) != 0) || (m_stop && mint_load_32_relaxed(m_stop) != 0)) {
+				mint_store_32_relaxed(&m_cancelled, 1);
+				return true;
+			}
+			// reading the clock is relatively slow, so only do it every so often;
+			// this bounds how far a search can overshoot its deadline
+			if (deadline > 0.0 && (++poll_count & (DEADLINE_POLL_INTERVAL - 1)) == 0 && get_time() >= deadline) {
+				timed_out = true;
+				mint_store_32_relaxed(&m_cancelled, 1);
+				return true;
+			}
+			return false;
+		}
 
 	private:
+		enum { DEADLINE_POLL_INTERVAL = 256 }; // must be a power of two
+		// rough ratio between the time taken by successive iterations
+		static const double ITERATION_GROWTH_ESTIMATE;
+
 		Evaluator evalfn;
+		EvalCache eval_cache;
 		int num_moves;
+		int num_evals;
+		int num_eval_hits;
 		int best_first_move;
-		mint_atomic32_t m_cancelled;
+		int completed_lookahead;
+		double deadline;
+		unsigned poll_count;
+		bool timed_out;
+		mutable mint_atomic32_t m_cancelled;
+		const Searcher *m_master;
+		mint_atomic32_t *m_stop;
 
 		virtual int do_search(const Board &board, const RNG &rng, int lookahead, int *move) = 0;
+
+		virtual void do_prepare(const Evaluator& /*evalfn*/) {}
+
+		virtual double do_search_afterstate(const Board& /*board*/, const RNG& /*rng*/, int /*lookahead*/) {
+			assert(0 && "this searcher can't search from an afterstate");
+			return (double)INT_MIN;
+		}
 };
 
+const double Searcher::ITERATION_GROWTH_ESTIMATE = 4.0;
+
 class SearcherCheat : public Searcher {
 	private:
 		int do_search_real(const Board &board, const RNG &rng, int lookahead, int *move) {
@@ -798,12 +1339,13 @@ class SearcherNaiveMinimax : public Searcher {
 			if (lookahead & 1) {
 				// minimise
 				best_score = INT_MAX;
+				next_state = board;
 				for (int i = 0; i < NUM_TILES; ++i) {
 					if (board.state[i]) { continue; } // can only place tiles in empty cells
 					for (int value = 1; value < 3; ++value) {
-						next_state = board;
-						next_state.state[i] = value;
+						next_state.make_placement(i, value);
 						int score = do_search_real(next_state, lookahead - 1, 0);
+						next_state.unmake_placement(i);
 						if (cancelled()) { return INT_MIN; }
 						if (score < best_score) {
 							best_score = score;
@@ -835,17 +1377,45 @@ class SearcherNaiveMinimax : public Searcher {
 };
 
 class SearcherAlphaBeta : public Searcher {
+	public:
+		SearcherAlphaBeta(): make_unmake(true), num_pruned(0), num_board_bytes(0) {}
+
+		// place tiles in the board being searched and take them away again (on by default),
+		// rather than placing each one in a fresh copy of the board
+		void set_make_unmake(bool enable) { make_unmake = enable; }
+
+		// an estimate of the bytes of board state read or written in the last search to set up
+		// children and to put boards back afterwards, counted as a fixed size per copy (both the
+		// read and the write) and per placement, not measured; tilts themselves and evaluation
+		// aren't counted, as they're the same either way
+		long long get_num_board_bytes() const { return num_board_bytes; }
+
 	private:
+		bool make_unmake;
 		int num_pruned;
+		long long num_board_bytes;
 
 		int do_search_mini(const Board &board, int alpha, int beta, int lookahead) {
 			Board next_state;
+			if (make_unmake) {
+				// one copy for all the children: each tile is placed and then taken away again
+				next_state = board;
+				num_board_bytes += 2*sizeof(Board);
+			}
 			for (int i = 0; i < NUM_TILES; ++i) {
 				if (board.state[i]) { continue; } // can only place tiles in empty cells
 				for (int value = 1; value < 3; ++value) {
-					next_state = board;
-					next_state.state[i] = value;
-					beta = min(beta, do_search_maxi(next_state, alpha, beta, lookahead - 1, 0));
+					if (make_unmake) {
+						next_state.make_placement(i, value);
+						beta = min(beta, do_search_maxi(next_state, alpha, beta, lookahead - 1, 0));
+						next_state.unmake_placement(i);
+						num_board_bytes += 2;
+					} else {
+						next_state = board;
+						next_state.state[i] = value;
+						beta = min(beta, do_search_maxi(next_state, alpha, beta, lookahead - 1, 0));
+						num_board_bytes += 2*sizeof(Board) + 1;
+					}
 					if (cancelled()) { return INT_MAX; }
 					if (alpha >= beta) { ++num_pruned; return beta; }
 				}
@@ -864,6 +1434,7 @@ class SearcherAlphaBeta : public Searcher {
 			Board next_state;
 			for (int i = 0; i < 4; ++i) {
 				next_state = board;
+				num_board_bytes += 2*sizeof(Board);
 				if (!next_state.tilt(DIR_DX[i], DIR_DY[i])) { continue; } // ignore null moves
 				tally_move();
 				int score = do_search_mini(next_state, alpha, beta, lookahead - 1);
@@ -880,6 +1451,7 @@ class SearcherAlphaBeta : public Searcher {
 		virtual int do_search(const Board &board, const RNG& /*rng*/, int lookahead, int *move) {
 			assert(lookahead >= 0);
 			num_pruned = 0;
+			num_board_bytes = 0;
 			int score = do_search_maxi(board, INT_MIN, INT_MAX, lookahead*2, move);
 #if PRINT_CACHE_STATS
 			printf("(alpha-beta) alpha-beta pruned %d\n", num_pruned);
@@ -888,65 +1460,233 @@ class SearcherAlphaBeta : public Searcher {
 		}
 };
 
-class SearcherCachingMinimax : public Searcher {
-	private:
-		struct Info { static const Info NIL; int lookahead; int score; };
-		BoardCache<Info> cache;
-		enum { STAT_DEPTH = 20 };
-		int num_cached[STAT_DEPTH];
+// The same search as SearcherAlphaBeta, but without recursion: the path from the root to the
+// node being searched is kept in a preallocated array of frames. All the state of a search is
+// in the searcher, so a search can be suspended after any number of nodes and resumed later
+// (for example, a slice per frame, or on a different thread -- but only one thread at a time).
+// A frame holds just its node's board, its alpha-beta window and the next child to try; its
+// lookahead (and so whether it's a max node or a min node) follows from its depth in the stack.
+class SearcherStackAlphaBeta : public Searcher {
+	public:
+		SearcherStackAlphaBeta():
+			num_frames(0), num_plies(0), root_move(-1), score(INT_MIN), num_pruned(0), num_suspends(0) {}
 
-		void tally_cache_hit(int lookahead) {
-			++num_cached[min(lookahead, STAT_DEPTH - 1)];
+		// sets up a search, but doesn't search anything; call resume() to run it
+		void start(const Evaluator &evalfn, const Board &board, int lookahead) {
+			assert(lookahead >= 0);
+			begin_search(evalfn, 0.0);
+			num_suspends = 0;
+			init(board, lookahead*2);
 		}
 
-		int do_search_real(const Board &board, int lookahead, int *move) {
-			if (move) { *move = -1; }
-
-			const uint64_t board_k = pack_board_state(board);
-			void *cache_loc = cache.where(board_k);
-			const Info *cached = cache.get(board_k, cache_loc);
-			if (cached && cached->lookahead == lookahead) {
-				tally_cache_hit(lookahead);
-				return cached->score;
+		// continues the search set up by start(), for at most max_nodes nodes (0 means no limit);
+		// returns true once the search has finished or been cancelled, at which point its
+		// result is available as for search()
+		bool resume(int max_nodes = 0) {
+			if (!run(max_nodes)) {
+				++num_suspends;
+				return false;
 			}
+			end_search(root_move, num_plies/2);
+			return true;
+		}
 
-			int best_score;
+		// the result of a finished search (INT_MIN if it was cancelled)
+		int get_score() const { return score; }
+		// the number of times resume() has returned before the search finished
+		int get_num_suspends() const { return num_suspends; }
 
-			if (lookahead == 0) {
-				if (cancelled()) { return INT_MIN; }
-				best_score = eval_board(board);
-			} else {
-				Board next_state;
-				if (lookahead & 1) {
+	private:
+		enum { MAX_FRAMES = 64 };
+
+		struct Frame {
+			Board board; // the position (min nodes and the root; other max nodes use the min node's board)
+			int alpha;
+			int beta;
+			int8_t next; // the next move (max nodes) or placement (min nodes; cell*2 + value-1) to try
+		};
+
+		Frame frames[MAX_FRAMES];
+		int num_frames;
+		int num_plies;
+		int root_move;
+		int score;
+		int num_pruned;
+		int num_suspends;
+
+		void init(const Board &board, int plies) {
+			assert(plies < MAX_FRAMES);
+			num_plies = plies;
+			root_move = -1;
+			num_pruned = 0;
+			if (plies == 0) {
+				num_frames = 0;
+				score = eval_board(board);
+				return;
+			}
+			score = INT_MIN;
+			Frame &root = frames[0];
+			root.board = board;
+			root.alpha = INT_MIN;
+			root.beta = INT_MAX;
+			root.next = 0;
+			num_frames = 1;
+		}
+
+		// passes a child's score to the node on top of the stack; nodes that are cut off are
+		// popped and pass their own scores on in turn; returns true if the root was popped
+		bool pass_up(int value) {
+			while (num_frames) {
+				Frame &f = frames[num_frames - 1];
+				if ((num_plies - num_frames + 1) & 1) {
 					// minimise
-					best_score = INT_MAX;
-					for (int i = 0; i < NUM_TILES; ++i) {
-						if (board.state[i]) { continue; } // can only place tiles in empty cells
-						for (int value = 1; value < 3; ++value) {
-							next_state = board;
-							next_state.state[i] = value;
-							int score = do_search_real(next_state, lookahead - 1, 0);
-							if (cancelled()) { return INT_MAX; }
-							if (score < best_score) {
-								best_score = score;
-							}
-						}
-					}
+					f.beta = min(f.beta, value);
+					if (f.alpha < f.beta) { return false; }
+					value = f.beta;
 				} else {
 					// maximise
-					best_score = INT_MIN;
-					for (int i = 0; i < 4; ++i) {
+					if (value > f.alpha) {
+						f.alpha = value;
+						if (num_frames == 1) { root_move = f.next - 1; }
+					}
+					if (f.alpha < f.beta) { return false; }
+					value = f.alpha;
+				}
+				++num_pruned;
+				--num_frames;
+			}
+			score = value;
+			return true;
+		}
+
+		// searches at most max_nodes nodes (0 means no limit); returns true if the search is finished
+		bool run(int max_nodes) {
+			for (int nodes = 0; num_frames; ++nodes) {
+				if (max_nodes && nodes == max_nodes) { return false; }
+				if (cancelled()) {
+					num_frames = 0;
+					score = INT_MIN;
+					return true;
+				}
+
+				Frame &f = frames[num_frames - 1];
+				const int lookahead = num_plies - num_frames + 1;
+				const Board *child;
+				if (lookahead & 1) {
+					// minimise: each tile is placed on the frame's own board, which its child
+					// searches from, and taken away again when the search comes back to the frame
+					if (f.next) { f.board.unmake_placement((f.next - 1) >> 1); }
+					while (f.next < NUM_TILES*2 && f.board.state[f.next >> 1]) { f.next += 2; } // can only place tiles in empty cells
+					if (f.next == NUM_TILES*2) {
+						--num_frames;
+						if (pass_up(f.beta)) { return true; }
+						continue;
+					}
+					f.board.make_placement(f.next >> 1, (f.next & 1) + 1);
+					child = &f.board;
+				} else {
+					// maximise: the child is built in the next frame, ready to be pushed; below the
+					// root, the position is the board of the min node above, with its tile placed
+					const Board &board = (num_frames > 1 ? frames[num_frames - 2].board : f.board);
+					Board &next_state = frames[num_frames].board;
+					for (; f.next < 4; ++f.next) {
 						next_state = board;
-						if (!next_state.tilt(DIR_DX[i], DIR_DY[i])) { continue; } // ignore null moves
-						tally_move();
+						if (next_state.tilt(DIR_DX[f.next], DIR_DY[f.next])) { break; } // ignore null moves
+					}
+					if (f.next == 4) {
+						--num_frames;
+						if (pass_up(f.alpha)) { return true; }
+						continue;
+					}
+					tally_move();
+					child = &next_state;
+				}
+				++f.next;
+
+				if (lookahead > 1) {
+					Frame &next = frames[num_frames++];
+					next.alpha = f.alpha;
+					next.beta = f.beta;
+					next.next = 0;
+				} else if (pass_up(eval_board(*child))) {
+					return true;
+				}
+			}
+			return true;
+		}
+
+		virtual int do_search(const Board &board, const RNG& /*rng*/, int lookahead, int *move) {
+			assert(lookahead >= 0);
+			init(board, lookahead*2);
+			run(0);
+			if (move) { *move = root_move; }
+#if PRINT_CACHE_STATS
+			printf("(stack-alpha-beta) alpha-beta pruned %d\n", num_pruned);
+#endif
+			return score;
+		}
+};
+
+class SearcherCachingMinimax : public Searcher {
+	private:
+		struct Info { static const Info NIL; int lookahead; int score; };
+		BoardCache<Info> cache;
+		enum { STAT_DEPTH = 20 };
+		int num_cached[STAT_DEPTH];
+
+		void tally_cache_hit(int lookahead) {
+			++num_cached[min(lookahead, STAT_DEPTH - 1)];
+		}
+
+		int do_search_real(const Board &board, int lookahead, int *move) {
+			if (move) { *move = -1; }
+
+			const uint64_t board_k = pack_board_state(board);
+			if (lookahead == 0) {
+				if (cancelled()) { return INT_MIN; }
+				// leaf scores live in the eval cache, so they can't push out interior nodes
+				return eval_board(board, board_k);
+			}
+
+			void *cache_loc = cache.where(board_k);
+			const Info *cached = cache.get(board_k, cache_loc);
+			if (cached && cached->lookahead == lookahead) {
+				tally_cache_hit(lookahead);
+				return cached->score;
+			}
+
+			int best_score;
+			Board next_state;
+			if (lookahead & 1) {
+				// minimise
+				best_score = INT_MAX;
+				next_state = board;
+				for (int i = 0; i < NUM_TILES; ++i) {
+					if (board.state[i]) { continue; } // can only place tiles in empty cells
+					for (int value = 1; value < 3; ++value) {
+						next_state.make_placement(i, value);
 						int score = do_search_real(next_state, lookahead - 1, 0);
-						if (cancelled()) { return INT_MIN; }
-						if (score > best_score) {
+						next_state.unmake_placement(i);
+						if (cancelled()) { return INT_MAX; }
+						if (score < best_score) {
 							best_score = score;
-							if (move) { *move = i; }
 						}
 					}
 				}
+			} else {
+				// maximise
+				best_score = INT_MIN;
+				for (int i = 0; i < 4; ++i) {
+					next_state = board;
+					if (!next_state.tilt(DIR_DX[i], DIR_DY[i])) { continue; } // ignore null moves
+					tally_move();
+					int score = do_search_real(next_state, lookahead - 1, 0);
+					if (cancelled()) { return INT_MIN; }
+					if (score > best_score) {
+						best_score = score;
+						if (move) { *move = i; }
+					}
+				}
 			}
 
 			const Info new_cached = { lookahead, best_score };
@@ -973,16 +1713,240 @@ const SearcherCachingMinimax::Info SearcherCachingMinimax::Info::NIL = { -1, INT
 class SearcherCachingAlphaBeta : public Searcher {
 	private:
 		enum { SCORE_UNKNOWN, SCORE_EXACT, SCORE_LOWER_BOUND, SCORE_UPPER_BOUND };
-		struct Info { static const Info NIL; int16_t lookahead; int16_t type; int score; };
-		BoardCache<Info> cache;
+		// best is the child that set the score last time the position was searched (a move for max
+		// nodes, a placement for min nodes), which is tried first when the position comes up again
+		struct Info { static const Info NIL; int16_t lookahead; int8_t type; int8_t best; int score; };
+
+	public:
+		typedef TieredBoardCache<Info>::SharedCache SharedCache;
+
+		// how min nodes order their placements (after the one suggested by the cache, if any)
+		enum PlacementOrder {
+			PLACEMENT_ORDER_CELLS,   // in cell order, a 2 and then a 4 in each cell
+			PLACEMENT_ORDER_EVAL,    // lowest evaluation of the board after the placement first
+			PLACEMENT_ORDER_HISTORY  // placements that have caused the most cutoffs first
+		};
+
+		SearcherCachingAlphaBeta():
+			move_rotation(0), cell_rotation(0), placement_order(PLACEMENT_ORDER_CELLS), move_heuristics(true),
+			cache_evalfn(0), pvs(false), mtdf(false), etc(true), aspiration_width(0), aspiration_growth(2),
+			have_last_score(false), last_score(0), scheduler(0), team(0), thread(0), task_lookahead(INT_MAX), split(0) {
+			memset(placement_history, 0, sizeof(placement_history));
+			memset(move_history, 0, sizeof(move_history));
+			memset(killers, -1, sizeof(killers));
+		}
+
+		// results searched to at least publish_lookahead plies are stored in the shared
+		// cache; shallower results stay in this searcher's private cache
+		void share_cache(SharedCache *shared, int publish_lookahead = 4) {
+			cache.share(shared, publish_lookahead);
+		}
+
+		// varies the order moves are tried in: the low two bits rotate the order of the player's
+		// moves (left, right, up, down), and the rest rotate the order of the cells new tiles are
+		// tried in; searchers that share a cache use different orders so that they don't all
+		// explore the same subtrees at the same time
+		void set_move_order(int order) {
+			move_rotation = (order & 3);
+			cell_rotation = ((order >> 2) % NUM_TILES);
+		}
+
+		// ordering placements so that the likely refutations come first gives more (and earlier)
+		// cutoffs at min nodes; ordering by evaluation searches the fewest nodes, but costs an
+		// evaluation per placement. History (cutoffs counted per cell and tile) turns out to be
+		// a poor guide, searching more nodes than plain cell order, so cell order is the default.
+		void set_placement_order(PlacementOrder order) { placement_order = order; }
+
+		// order max node moves (after the cache's hint) by killer move (the last move to cause a
+		// cutoff at the same lookahead), and then by history (how many cutoffs each direction has
+		// caused, weighted towards cutoffs near the root); on by default
+		void set_move_heuristics(bool enabled) { move_heuristics = enabled; }
+
+		// enhanced transposition cutoffs: before searching a max node's moves, look up the
+		// position after each move in the cache; if one of them is already known to score at
+		// least beta, the node fails high straight away, without searching anything; on by default
+		void set_transposition_cutoffs(bool enabled) { etc = enabled; }
+
+		// number of max nodes in the last search that were cut off by a cache probe (ie, the
+		// number of full subtree searches avoided)
+		int get_num_transposition_cutoffs() const { return num_etc_cutoffs; }
+
+		// number of max nodes in the last search whose best move is known (ie, they didn't fail
+		// low), and how many of them found it with the first move they tried
+		int get_num_best_moves() const { return num_best_known; }
+		int get_num_first_moves_best() const { return num_first_best; }
+
+		// Principal Variation Search: once a node's first child has been searched, search the rest
+		// with a null window, which only proves whether they're better than the best so far (and
+		// prunes much more); a child that turns out to be better is searched again with the full
+		// window. Only applies to nodes searched serially (not YBWC split nodes).
+		void set_pvs(bool enabled) { pvs = enabled; }
+
+		// number of null window searches that failed and had to be repeated in the last search
+		int get_num_researches() const { return num_researches; }
+
+		// MTD(f): find the root score with a series of null window searches, each of which
+		// proves that the score is above or below a guess; the first guess is the score of the
+		// previous search (ie, the previous iteration, or the previous move), and the cache
+		// keeps the bounds found by each pass, so later passes mostly come from the cache
+		void set_mtdf(bool enabled) { mtdf = enabled; }
+
+		// number of null window passes made by the last MTD(f) search
+		int get_num_passes() const { return num_passes; }
+
+		// aspiration windows: search the root with a window of +/- width around the score of the
+		// previous search (the previous iteration, or the previous move); if the score falls
+		// outside the window, search again with that side of the window moved out by a margin
+		// that starts at width and is multiplied by growth after each failure
+		// (width 0 turns aspiration windows off, which is the default)
+		void set_aspiration(int width, int growth = 2) {
+			assert(width >= 0 && growth >= 1);
+			aspiration_width = width;
+			aspiration_growth = growth;
+		}
+
+		// number of times the last search had to widen its aspiration window
+		int get_num_aspiration_fails() const { return num_aspiration_fails; }
+
+		// makes this searcher thread number `thread` of a parallel search: nodes with at least
+		// task_lookahead plies to go search their eldest child, and then hand the rest to the
+		// scheduler as tasks; team[i] is the searcher that runs tasks for scheduler thread i
+		void join_team(WorkStealingScheduler *scheduler, SearcherCachingAlphaBeta * const *team, int thread, int task_lookahead) {
+			this->scheduler = scheduler;
+			this->team = team;
+			this->thread = thread;
+			this->task_lookahead = task_lookahead;
+		}
+
+		// the main function for the helper threads of a parallel search: runs tasks (on
+		// behalf of the team member on thread 0) until the scheduler is told to stop
+		void help(const Evaluator &evalfn) {
+			assert(scheduler && thread > 0);
+			begin_search(evalfn, 0.0);
+			begin();
+			scheduler->work(thread);
+			end_search();
+		}
+
+		// parallel search statistics for the last search (counting only tasks run by this searcher):
+		// the number of times a task produced a cutoff that aborted its siblings, and the number of
+		// moves searched by tasks that were aborted (ie, work that was thrown away)
+		int get_num_aborts() const { return num_aborts; }
+		int get_num_wasted_moves() const { return num_wasted_moves; }
+
+		// number of cutoffs in the last search, and how many of those were made by the first
+		// child searched (the better the move ordering, the closer these two are); either in
+		// total, or at nodes with a particular lookahead
+		int get_num_cutoffs() const { return sum_stat(num_pruned); }
+		int get_num_first_child_cutoffs() const { return sum_stat(num_first_pruned); }
+		int get_num_cutoffs(int lookahead) const { return num_pruned[min(lookahead, STAT_DEPTH - 1)]; }
+		int get_num_first_child_cutoffs(int lookahead) const { return num_first_pruned[min(lookahead, STAT_DEPTH - 1)]; }
+
+	private:
+		// a node whose children are being searched in parallel; a cutoff in one child
+		// aborts the rest, and aborting a node aborts everything below it too
+		struct SplitPoint {
+			const SplitPoint *parent;
+			mint_atomic32_t aborted;
+		};
+
+		// one child of a split node, searched by whichever thread picks it up
+		struct SplitTask {
+			SearcherCachingAlphaBeta * const *team;
+			SearcherCachingAlphaBeta *searcher; // the team member that ran the task
+			SplitPoint *split;
+			Board board;
+			int index; // the move or placement that leads to this child
+			bool maxi_parent;
+			int alpha;
+			int beta;
+			int lookahead;
+			int score;
+			bool valid; // false if the task was aborted or cancelled
+		};
+
+		TieredBoardCache<Info> cache;
+		int move_rotation;
+		int cell_rotation;
+		PlacementOrder placement_order;
+		// the history tables are aged (halved) at the start of each search, rather than cleared,
+		// so that they carry over between iterations and moves (killers are just overwritten)
+		int placement_history[NUM_TILES*2];
+		bool move_heuristics;
+		int move_history[4];
+		EvalFn cache_evalfn;
+		bool pvs;
+		bool mtdf;
+		bool etc;
+		int aspiration_width;
+		int aspiration_growth;
+		bool have_last_score;
+		int last_score;
 		enum { STAT_DEPTH = 20 };
+		enum { ETC_MIN_LOOKAHEAD = 4 };
 		int num_cached[STAT_DEPTH];
-		int num_pruned;
+		int num_pruned[STAT_DEPTH];
+		int num_first_pruned[STAT_DEPTH];
+		int killers[STAT_DEPTH];
+		int num_best_known;
+		int num_first_best;
+		int num_researches;
+		int num_passes;
+		int num_aspiration_fails;
+		int num_etc_cutoffs;
+		WorkStealingScheduler *scheduler;
+		SearcherCachingAlphaBeta * const *team;
+		int thread;
+		int task_lookahead;
+		const SplitPoint *split; // the innermost split node that the current task belongs to
+		int task_moves;
+		int num_aborts;
+		int num_wasted_moves;
 
 		void tally_cache_hit(int lookahead) {
 			++num_cached[min(lookahead, STAT_DEPTH - 1)];
 		}
 
+		static int sum_stat(const int *stat) {
+			int total = 0;
+			for (int i = 0; i < STAT_DEPTH; ++i) { total += stat[i]; }
+			return total;
+		}
+
+		// index is the child that caused the cutoff, and first says whether it was the first
+		// child searched
+		void tally_cutoff(bool maxi, int lookahead, int index, bool first) {
+			++num_pruned[min(lookahead, STAT_DEPTH - 1)];
+			if (first) { ++num_first_pruned[min(lookahead, STAT_DEPTH - 1)]; }
+			// cutoffs near the root save more work, so they count for more
+			if (maxi) {
+				killers[min(lookahead, STAT_DEPTH - 1)] = index;
+				move_history[index] += lookahead * lookahead;
+			} else {
+				placement_history[index] += lookahead * lookahead;
+			}
+		}
+
+		// called for each max node that searched at least one move
+		void tally_best_move(int cache_type, int first, int best) {
+			if (cache_type == SCORE_UPPER_BOUND) { return; } // failed low: no best move
+			++num_best_known;
+			if (best == first) { ++num_first_best; }
+		}
+
+		static bool split_aborted(const SplitPoint *sp) {
+			for (; sp; sp = sp->parent) {
+				if (mint_load_32_relaxed(const_cast<mint_atomic32_t*>(&sp->aborted)) != 0) { return true; }
+			}
+			return false;
+		}
+
+		// like cancelled(), but also true when a sibling of the current task (or of one of
+		// its ancestors) has made a cutoff; results found after this must be thrown away
+		bool stopped() {
+			return (cancelled() || split_aborted(split));
+		}
+
 		bool check_cached(const Info * const cached, int alpha, int beta, int lookahead, int &output) {
 			bool cache_valid = false;
 			if (cached && cached->lookahead == lookahead) {
@@ -999,40 +1963,274 @@ class SearcherCachingAlphaBeta : public Searcher {
 			return cache_valid;
 		}
 
+		// looks up the position after each of a max node's moves, and returns the move whose
+		// cached score is at least beta (or -1 if there isn't one); score is set to that score
+		int probe_children(const Board &board, int beta, int lookahead, int &score) {
+			Board next_state;
+			for (int i = 0; i < 4; ++i) {
+				next_state = board;
+				if (!next_state.tilt(DIR_DX[i], DIR_DY[i])) { continue; }
+				const uint64_t k = pack_board_state(next_state);
+				const Info * const cached = cache.get(k, cache.where(k), lookahead - 1);
+				// min nodes always have odd lookahead and max nodes even, so an entry with the
+				// right lookahead is for the right kind of node
+				if (cached && cached->lookahead == lookahead - 1 && cached->score >= beta &&
+						(cached->type == SCORE_EXACT || cached->type == SCORE_LOWER_BOUND)) {
+					score = cached->score;
+					return i;
+				}
+			}
+			return -1;
+		}
+
+		// max nodes and min nodes can have the same key, so only take a hint from an entry
+		// for the same kind of node (ie, with the same lookahead parity)
+		static int hint_from(const Info *cached, int lookahead) {
+			return ((cached && ((cached->lookahead ^ lookahead) & 1) == 0) ? cached->best : -1);
+		}
+
+		// children are numbered: a max node's children by move direction, and a min node's
+		// children by placement (cell*2 for a 2, cell*2 + 1 for a 4); puts the numbers of the
+		// children worth trying into order, with `first` (if it's valid) at the front
+		int order_children(const Board &board, bool maxi, int lookahead, int first, int *order) {
+			int n = 0;
+			if (first >= 0) { order[n++] = first; }
+			if (maxi) {
+				for (int j = 0; j < 4; ++j) {
+					const int i = ((j + move_rotation) & 3);
+					if (i != first) { order[n++] = i; }
+				}
+				if (move_heuristics) {
+					const int begin = (first >= 0 ? 1 : 0);
+					const int killer = killers[min(lookahead, STAT_DEPTH - 1)];
+					int keys[4];
+					for (int k = begin; k < n; ++k) {
+						keys[k] = (order[k] == killer ? INT_MAX : move_history[order[k]]);
+					}
+					sort_by_keys(order + begin, keys + begin, n - begin);
+				}
+			} else {
+				if (first >= 0 && board.state[first / 2]) { n = 0; } // stale placement
+				for (int j = 0; j < NUM_TILES; ++j) {
+					const int i = ((j + cell_rotation) % NUM_TILES);
+					if (board.state[i]) { continue; } // can only place tiles in empty cells
+					if (i*2 != first) { order[n++] = i*2; }
+					if (i*2 + 1 != first) { order[n++] = i*2 + 1; }
+				}
+				if (placement_order != PLACEMENT_ORDER_CELLS) {
+					const int begin = (n > 0 && order[0] == first ? 1 : 0);
+					sort_placements(board, order + begin, n - begin);
+				}
+			}
+			return n;
+		}
+
+		// sorts placements into descending order of how damaging they're likely to be
+		void sort_placements(const Board &board, int *order, int n) {
+			int keys[NUM_TILES*2];
+			Board next_state = board;
+			for (int k = 0; k < n; ++k) {
+				if (placement_order == PLACEMENT_ORDER_EVAL) {
+					next_state.make_placement(order[k] / 2, (order[k] & 1) + 1);
+					keys[k] = -eval_board(next_state);
+					next_state.unmake_placement(order[k] / 2);
+				} else {
+					keys[k] = placement_history[order[k]];
+				}
+			}
+			sort_by_keys(order, keys, n);
+		}
+
+		// sorts children into descending order of key (stable, so children that tie keep
+		// their original order)
+		static void sort_by_keys(int *order, int *keys, int n) {
+			for (int k = 1; k < n; ++k) {
+				const int key = keys[k];
+				const int child = order[k];
+				int j = k;
+				for (; j > 0 && keys[j - 1] < key; --j) {
+					keys[j] = keys[j - 1];
+					order[j] = order[j - 1];
+				}
+				keys[j] = key;
+				order[j] = child;
+			}
+		}
+
+		// folds a child's score into a node's window and its score so far (value); returns true
+		// if the rest can be pruned. The search is fail-soft: the value of a node that fails
+		// high or low is the best bound its children gave, not just the edge of the window.
+		bool merge_child(bool maxi, int score, int index, int &alpha, int &beta, int &value, int &cache_type, int &best, int *move) {
+			value = (maxi ? max(value, score) : min(value, score));
+			if (maxi) {
+				if (score > alpha) {
+					alpha = score;
+					cache_type = SCORE_EXACT;
+					best = index;
+					if (move) { *move = index; }
+				}
+			} else {
+				if (score < beta) {
+					beta = score;
+					cache_type = SCORE_EXACT;
+					best = index;
+				}
+			}
+			if (alpha >= beta) {
+				cache_type = (maxi ? SCORE_LOWER_BOUND : SCORE_UPPER_BOUND);
+				return true;
+			}
+			return false;
+		}
+
+		static void split_task_main(void *data, int thread) {
+			SplitTask &task = *static_cast<SplitTask*>(data);
+			task.searcher = task.team[thread];
+			SearcherCachingAlphaBeta &searcher = *task.searcher;
+			// this thread may have been in the middle of something else when it picked up the task
+			const SplitPoint * const saved_split = searcher.split;
+			const int saved_task_moves = searcher.task_moves;
+			searcher.split = task.split;
+			searcher.task_moves = 0;
+
+			task.valid = false;
+			if (!searcher.stopped()) {
+				if (task.maxi_parent) {
+					task.score = searcher.do_search_mini(task.board, task.alpha, task.beta, task.lookahead);
+				} else {
+					task.score = searcher.do_search_maxi(task.board, task.alpha, task.beta, task.lookahead, 0);
+				}
+				task.valid = !searcher.stopped();
+			}
+			if (task.valid && (task.maxi_parent ? task.score >= task.beta : task.score <= task.alpha)) {
+				// a cutoff: the siblings' results aren't needed
+				mint_store_32_relaxed(&task.split->aborted, 1);
+				++searcher.num_aborts;
+			}
+			if (!task.valid) { searcher.num_wasted_moves += searcher.task_moves; }
+
+			searcher.split = saved_split;
+			searcher.task_moves = saved_task_moves;
+		}
+
+		// Young Brothers Wait: the eldest child is searched first, on its own, to narrow the
+		// window; then the remaining children are searched in parallel with that window.
+		// Returns the node's score.
+		int search_split(const Board &board, bool maxi, int alpha, int beta, int lookahead, int &cache_type, int &best, int *move) {
+			int value = (maxi ? INT_MIN : INT_MAX);
+			SplitTask tasks[NUM_TILES*2];
+			int order[NUM_TILES*2];
+			const int norder = order_children(board, maxi, lookahead, best, order);
+			int n = 0;
+			for (int k = 0; k < norder; ++k) {
+				const int i = order[k];
+				SplitTask &task = tasks[n];
+				task.board = board;
+				if (maxi) {
+					if (!task.board.tilt(DIR_DX[i], DIR_DY[i])) { continue; } // ignore null moves
+					tally_move();
+					++task_moves;
+				} else {
+					task.board.state[i / 2] = (i & 1) + 1;
+				}
+				task.index = i;
+				++n;
+			}
+			if (n == 0) { return value; }
+
+			int score = (maxi
+					? do_search_mini(tasks[0].board, alpha, beta, lookahead - 1)
+					: do_search_maxi(tasks[0].board, alpha, beta, lookahead - 1, 0));
+			if (stopped()) { return (maxi ? INT_MIN : INT_MAX); }
+			if (merge_child(maxi, score, tasks[0].index, alpha, beta, value, cache_type, best, move)) {
+				tally_cutoff(maxi, lookahead, tasks[0].index, true);
+				if (maxi) { tally_best_move(cache_type, tasks[0].index, best); }
+				return value;
+			}
+
+			SplitPoint sp;
+			sp.parent = split;
+			sp.aborted._nonatomic = 0;
+			mint_atomic32_t pending;
+			pending._nonatomic = 0;
+			for (int i = 1; i < n; ++i) {
+				SplitTask &task = tasks[i];
+				task.team = team;
+				task.searcher = 0;
+				task.split = &sp;
+				task.maxi_parent = maxi;
+				task.alpha = alpha;
+				task.beta = beta;
+				task.lookahead = lookahead - 1;
+				task.score = 0;
+				task.valid = false;
+				scheduler->spawn(thread, &split_task_main, &task, &pending);
+			}
+			scheduler->wait(thread, &pending);
+			for (int i = 1; i < n; ++i) {
+				// the other threads poll the deadline separately, so pick up their timeouts
+				if (!tasks[i].valid) { merge_timeout(*tasks[i].searcher); }
+			}
+			if (stopped()) { return (maxi ? INT_MIN : INT_MAX); }
+
+			for (int i = 1; i < n; ++i) {
+				if (!tasks[i].valid) { continue; } // aborted by a sibling's cutoff
+				if (merge_child(maxi, tasks[i].score, tasks[i].index, alpha, beta, value, cache_type, best, move)) {
+					tally_cutoff(maxi, lookahead, tasks[i].index, false);
+					break;
+				}
+			}
+			if (maxi) { tally_best_move(cache_type, tasks[0].index, best); }
+			return value;
+		}
+
 		int do_search_mini(const Board &board, int alpha, int beta, int lookahead) {
 			assert(alpha < beta);
 
 			const uint64_t board_k = pack_board_state(board);
 			void * const cache_loc = cache.where(board_k);
 
-			const Info * const cached = cache.get(board_k, cache_loc);
+			const Info * const cached = cache.get(board_k, cache_loc, lookahead);
 			int cache_output;
 			if (check_cached(cached, alpha, beta, lookahead, cache_output)) { return cache_output; }
+			// the placement that refuted the player's move last time is likely to refute it again
+			int best = hint_from(cached, lookahead);
 
 			int cache_type = SCORE_LOWER_BOUND;
-			Board next_state;
-			for (int i = 0; i < NUM_TILES; ++i) {
-				if (board.state[i]) { continue; } // can only place tiles in empty cells
-				for (int value = 1; value < 3; ++value) {
-					next_state = board;
-					next_state.state[i] = value;
-					int score = do_search_maxi(next_state, alpha, beta, lookahead - 1, 0);
-					if (cancelled()) { return INT_MAX; }
-					if (score < beta) {
-						beta = score;
-						cache_type = SCORE_EXACT;
+			int value = INT_MAX;
+			if (scheduler && lookahead >= task_lookahead) {
+				value = search_split(board, false, alpha, beta, lookahead, cache_type, best, 0);
+				if (stopped()) { return INT_MAX; }
+			} else {
+				int order[NUM_TILES*2];
+				const int n = order_children(board, false, lookahead, best, order);
+				// one copy for all the children: each tile is placed and then taken away again
+				Board next_state = board;
+				for (int k = 0; k < n; ++k) {
+					const int i = order[k];
+					next_state.make_placement(i / 2, (i & 1) + 1);
+					int score;
+					if (pvs && k > 0) {
+						score = do_search_maxi(next_state, beta - 1, beta, lookahead - 1, 0);
+						if (!stopped() && score < beta && score > alpha) {
+							++num_researches;
+							score = do_search_maxi(next_state, alpha, beta, lookahead - 1, 0);
+						}
+					} else {
+						score = do_search_maxi(next_state, alpha, beta, lookahead - 1, 0);
 					}
-					if (alpha >= beta) {
-						++num_pruned;
-						cache_type = SCORE_UPPER_BOUND;
-						goto prune;
+					next_state.unmake_placement(i / 2);
+					if (stopped()) { return INT_MAX; }
+					if (merge_child(false, score, i, alpha, beta, value, cache_type, best, 0)) {
+						tally_cutoff(false, lookahead, i, (k == 0));
+						break;
 					}
 				}
 			}
-prune:
-			const Info new_cached = { (int16_t)lookahead, (int16_t)cache_type, beta };
-			cache.put(board_k, cache_loc, new_cached);
-			return beta;
+
+			const Info new_cached = { (int16_t)lookahead, (int8_t)cache_type, (int8_t)best, value };
+			cache.put(board_k, cache_loc, lookahead, new_cached);
+			return value;
 		}
 
 		int do_search_maxi(const Board &board, int alpha, int beta, int lookahead, int *move) {
@@ -1040,63 +2238,1566 @@ prune:
 			assert(alpha < beta);
 
 			const uint64_t board_k = pack_board_state(board);
+			if (lookahead == 0) {
+				if (stopped()) { return INT_MIN; }
+				// leaf scores live in the eval cache, so they can't push out interior nodes
+				return eval_board(board, board_k);
+			}
+
 			void * const cache_loc = cache.where(board_k);
 
-			const Info * const cached = cache.get(board_k, cache_loc);
+			const Info * const cached = cache.get(board_k, cache_loc, lookahead);
+			// the best move last time (even from a shallower search) is likely to be good again
+			int best = hint_from(cached, lookahead);
+			// at the root, a cached score is only any use along with the move that gets it
+			const bool cached_move_valid = (!move || (best >= 0 && board.can_move(best)));
 			int cache_output;
-			if (check_cached(cached, alpha, beta, lookahead, cache_output)) { return cache_output; }
+			if (cached_move_valid && check_cached(cached, alpha, beta, lookahead, cache_output)) {
+				if (move) { *move = best; }
+				return cache_output;
+			}
 
-			if (lookahead == 0) {
-				if (cancelled()) { return INT_MIN; }
-				int score = eval_board(board);
-				const Info new_cached = { 0, SCORE_EXACT, score };
-				cache.put(board_k, cache_loc, new_cached);
-				return score;
+			// a lost position (no moves) scores INT_MIN
+			int cache_type = SCORE_UPPER_BOUND;
+			int value = INT_MIN;
+			int etc_move = -1;
+			// near the leaves, probing costs about as much as just searching the moves
+			if (etc && lookahead >= ETC_MIN_LOOKAHEAD && beta < INT_MAX) { etc_move = probe_children(board, beta, lookahead, value); }
+			if (etc_move >= 0) {
+				++num_etc_cutoffs;
+				cache_type = SCORE_LOWER_BOUND;
+				best = etc_move;
+				if (move) { *move = etc_move; }
+			} else if (scheduler && lookahead >= task_lookahead) {
+				value = search_split(board, true, alpha, beta, lookahead, cache_type, best, move);
+				if (stopped()) { return INT_MIN; }
 			} else {
-				int cache_type = SCORE_UPPER_BOUND;
+				int order[4];
+				const int n = order_children(board, true, lookahead, best, order);
 				Board next_state;
-				for (int i = 0; i < 4; ++i) {
+				int searched = 0;
+				int first_move = -1;
+				for (int k = 0; k < n; ++k) {
+					const int i = order[k];
 					next_state = board;
 					if (!next_state.tilt(DIR_DX[i], DIR_DY[i])) { continue; } // ignore null moves
 					tally_move();
-					int score = do_search_mini(next_state, alpha, beta, lookahead - 1);
-					if (cancelled()) { return INT_MIN; }
-					if (score > alpha) {
-						alpha = score;
-						cache_type = SCORE_EXACT;
-						if (move) { *move = i; }
+					++task_moves;
+					if (searched == 0) { first_move = i; }
+					int score;
+					if (pvs && searched > 0) {
+						score = do_search_mini(next_state, alpha, alpha + 1, lookahead - 1);
+						if (!stopped() && score > alpha && score < beta) {
+							++num_researches;
+							score = do_search_mini(next_state, alpha, beta, lookahead - 1);
+						}
+					} else {
+						score = do_search_mini(next_state, alpha, beta, lookahead - 1);
 					}
-					if (alpha >= beta) {
-						++num_pruned;
-						cache_type = SCORE_LOWER_BOUND;
-						goto prune;
+					if (stopped()) { return INT_MIN; }
+					if (merge_child(true, score, i, alpha, beta, value, cache_type, best, move)) {
+						tally_cutoff(true, lookahead, i, (searched == 0));
+						break;
 					}
+					++searched;
+				}
+				if (first_move >= 0) { tally_best_move(cache_type, first_move, best); }
+			}
+
+			const Info new_cached = { (int16_t)lookahead, (int8_t)cache_type, (int8_t)best, value };
+			cache.put(board_k, cache_loc, lookahead, new_cached);
+			return value;
+		}
+
+		int search_mtdf(const Board &board, int lookahead, int *move) {
+			if (move) { *move = -1; }
+			int lower = INT_MIN;
+			int upper = INT_MAX;
+			int score = (have_last_score ? last_score : eval_board(board));
+			while (lower < upper) {
+				const int beta = (score == lower ? score + 1 : score);
+				int pass_move;
+				score = do_search_maxi(board, beta - 1, beta, lookahead, &pass_move);
+				if (stopped()) { return INT_MIN; }
+				++num_passes;
+				if (score < beta) {
+					upper = score;
+				} else {
+					// the move that proved the score is at least `lower`
+					lower = score;
+					if (move) { *move = pass_move; }
+				}
+			}
+			return score;
+		}
+
+		int search_aspiration(const Board &board, int lookahead, int *move) {
+			const int64_t guess = (have_last_score ? last_score : eval_board(board));
+			int64_t margin = aspiration_width;
+			int alpha = (int)max((int64_t)INT_MIN, guess - margin);
+			int beta = (int)min((int64_t)INT_MAX, guess + margin);
+			while (true) {
+				const int score = do_search_maxi(board, alpha, beta, lookahead, move);
+				if (stopped()) { return INT_MIN; }
+				// the search is fail-soft, so a failed search gives a bound to widen from
+				if (score <= alpha && alpha > INT_MIN) {
+					alpha = (int)max((int64_t)INT_MIN, (int64_t)score - margin);
+				} else if (score >= beta && beta < INT_MAX) {
+					beta = (int)min((int64_t)INT_MAX, (int64_t)score + margin);
+				} else {
+					return score;
 				}
-prune:
-				const Info new_cached = { (int16_t)lookahead, (int16_t)cache_type, alpha };
-				cache.put(board_k, cache_loc, new_cached);
-				return alpha;
+				++num_aspiration_fails;
+				margin *= aspiration_growth;
+			}
+		}
+
+		void begin() {
+			memset(num_cached, 0, sizeof(num_cached));
+			memset(num_pruned, 0, sizeof(num_pruned));
+			memset(num_first_pruned, 0, sizeof(num_first_pruned));
+			for (int i = 0; i < NUM_TILES*2; ++i) { placement_history[i] /= 2; }
+			for (int i = 0; i < 4; ++i) { move_history[i] /= 2; }
+			num_best_known = 0;
+			num_first_best = 0;
+			num_researches = 0;
+			num_passes = 0;
+			num_aspiration_fails = 0;
+			num_etc_cutoffs = 0;
+			split = 0;
+			task_moves = 0;
+			num_aborts = 0;
+			num_wasted_moves = 0;
+			// (help() doesn't go through prepare())
+			do_prepare(evaluator());
+		}
+
+		// entries stay valid between searches as long as the evaluator doesn't change, and
+		// keeping them means each iteration of iterative deepening gets the best moves
+		// found by the previous one
+		virtual void do_prepare(const Evaluator &evalfn) {
+			if (evalfn.fn != cache_evalfn) {
+				cache.reset();
+				cache_evalfn = evalfn.fn;
+			}
+		}
+
+		virtual double do_search_afterstate(const Board &board, const RNG& /*rng*/, int lookahead) {
+			begin();
+			return do_search_mini(board, INT_MIN, INT_MAX, lookahead*2 - 1);
+		}
+
+		virtual int do_search(const Board &board, const RNG& /*rng*/, int lookahead, int *move) {
+			assert(lookahead >= 0);
+			begin();
+			int score;
+			if (mtdf) {
+				score = search_mtdf(board, lookahead*2, move);
+			} else if (aspiration_width > 0) {
+				score = search_aspiration(board, lookahead*2, move);
+			} else {
+				score = do_search_maxi(board, INT_MIN, INT_MAX, lookahead*2, move);
+			}
+			if (!stopped()) {
+				have_last_score = true;
+				last_score = score;
+			}
+#if PRINT_CACHE_STATS
+			if (mtdf) { printf("(caching-alpha-beta) mtd(f) passes %d\n", num_passes); }
+			if (aspiration_width) { printf("(caching-alpha-beta) aspiration window fails %d\n", num_aspiration_fails); }
+			printf("(caching-alpha-beta) alpha-beta pruned (by the first child / in total):");
+			for (int i = 0; i < min(lookahead*2, STAT_DEPTH); ++i) { printf(" %d/%d", num_first_pruned[i], num_pruned[i]); }
+			printf("\n");
+			if (pvs) { printf("(caching-alpha-beta) null window re-searches %d\n", num_researches); }
+			if (etc) { printf("(caching-alpha-beta) transposition cutoffs %d\n", num_etc_cutoffs); }
+			printf("(caching-alpha-beta) cache hits:");
+			for (int i = 0; i < min(lookahead*2, STAT_DEPTH); ++i) { printf(" %d", num_cached[i]); }
+			printf("\n");
+#endif
+			return score;
+		}
+};
+
+const SearcherCachingAlphaBeta::Info SearcherCachingAlphaBeta::Info::NIL = { -1, SCORE_UNKNOWN, -1, INT_MIN };
+
+// Maximises the *expected* score: new tiles are placed at random (uniformly over the empty
+// cells, a 2 with probability 0.9 and a 4 with probability 0.1), rather than adversarially.
+class SearcherExpectimax : public Searcher {
+	private:
+		// probability is the path probability the score was searched with: with the probability
+		// cutoff, a subtree reached with a lower probability is cut off sooner
+		struct Info { int lookahead; float probability; float score; };
+
+	public:
+		typedef TieredBoardCache<Info>::SharedCache SharedCache;
+
+		SearcherExpectimax():
+			min_probability(0.0001f), keep_cache(true), cache_evalfn(0), cache_min_probability(0.0f),
+			scheduler(0), team(0), thread(0), task_lookahead(INT_MAX) {}
+
+		// results searched to at least publish_lookahead plies are stored in the shared
+		// cache; shallower results stay in this searcher's private cache
+		void share_cache(SharedCache *shared, int publish_lookahead = 4) {
+			cache.share(shared, publish_lookahead);
+		}
+
+		// makes this searcher thread number `thread` of a parallel search: chance nodes with at
+		// least task_lookahead plies to go hand their children to the scheduler as tasks, and
+		// team[i] is the searcher that runs tasks for scheduler thread i
+		void join_team(WorkStealingScheduler *scheduler, SearcherExpectimax * const *team, int thread, int task_lookahead) {
+			this->scheduler = scheduler;
+			this->team = team;
+			this->thread = thread;
+			this->task_lookahead = task_lookahead;
+		}
+
+		// the main function for the helper threads of a parallel search: runs tasks (on
+		// behalf of the team member on thread 0) until the scheduler is told to stop
+		void help(const Evaluator &evalfn) {
+			assert(scheduler && thread > 0);
+			begin_search(evalfn, 0.0);
+			begin();
+			scheduler->work(thread);
+			end_search();
+		}
+
+		// positions reached with a probability below this are evaluated without searching deeper
+		// (set it to 0 to search the full tree)
+		void set_probability_cutoff(float p) { assert(p >= 0.0f); min_probability = p; }
+
+		// number of subtrees skipped by the probability cutoff in the last search
+		int get_num_cutoffs() const {
+			int total = 0;
+			for (int i = 0; i < STAT_DEPTH; ++i) { total += num_cutoff[i]; }
+			return total;
+		}
+
+		// keep cached results from one search to the next (as long as the evaluator doesn't
+		// change); after a move and a new tile, the new position was searched two plies less
+		// deeply by the last search, so its shallower iterations come straight from the cache.
+		// On by default. A cached score is only used if it was searched with at least the
+		// path probability the new search reaches it with (so it was cut off no sooner).
+		void set_keep_cache(bool keep) { keep_cache = keep; }
+
+	private:
+		TieredBoardCache<Info> cache;
+		enum { STAT_DEPTH = 20 };
+		int num_cached[STAT_DEPTH];
+		int num_cutoff[STAT_DEPTH];
+		float min_probability;
+		bool keep_cache;
+		EvalFn cache_evalfn;
+		float cache_min_probability;
+		WorkStealingScheduler *scheduler;
+		SearcherExpectimax * const *team;
+		int thread;
+		int task_lookahead;
+
+		// one child of a chance node, searched as a task by whichever thread picks it up
+		struct ChanceTask {
+			SearcherExpectimax * const *team;
+			SearcherExpectimax *searcher; // the team member that ran the task
+			Board board;
+			float probability;
+			int lookahead;
+			float score;
+			bool cancelled;
+		};
+
+		static void chance_task_main(void *data, int thread) {
+			ChanceTask &task = *static_cast<ChanceTask*>(data);
+			task.searcher = task.team[thread];
+			task.score = task.searcher->do_search_maxi(task.board, task.probability, task.lookahead, 0);
+			task.cancelled = task.searcher->cancelled();
+		}
+
+		void tally_cache_hit(int lookahead) {
+			++num_cached[min(lookahead, STAT_DEPTH - 1)];
+		}
+
+		void tally_cutoff(int lookahead) {
+			++num_cutoff[min(lookahead, STAT_DEPTH - 1)];
+		}
+
+		bool cache_usable(const Info *cached, float probability, int lookahead) const {
+			return cached && cached->lookahead == lookahead
+				&& (min_probability == 0.0f || cached->probability >= probability);
+		}
+
+		float do_search_chance(const Board &board, float probability, int lookahead) {
+			const uint64_t board_k = pack_board_state(board);
+			void * const cache_loc = cache.where(board_k);
+			const Info * const cached = cache.get(board_k, cache_loc, lookahead);
+			if (cache_usable(cached, probability, lookahead)) {
+				tally_cache_hit(lookahead);
+				return cached->score;
+			}
+
+			uint8_t free[NUM_TILES];
+			const int nfree = board.count_free(free);
+			assert(nfree > 0); // a move that changes the board always leaves a free cell
+
+			const float p2 = probability * (0.9f / nfree);
+			const float p4 = probability * (0.1f / nfree);
+			float total = 0.0f;
+			if (scheduler && lookahead >= task_lookahead) {
+				ChanceTask tasks[NUM_TILES*2];
+				mint_atomic32_t pending;
+				pending._nonatomic = 0;
+				for (int i = 0; i < nfree*2; ++i) {
+					ChanceTask &task = tasks[i];
+					task.team = team;
+					task.searcher = 0;
+					task.board = board;
+					task.board.state[free[i/2]] = (i & 1) + 1;
+					task.probability = ((i & 1) ? p4 : p2);
+					task.lookahead = lookahead - 1;
+					task.score = 0.0f;
+					task.cancelled = false;
+					scheduler->spawn(thread, &chance_task_main, &task, &pending);
+				}
+				scheduler->wait(thread, &pending);
+				for (int i = 0; i < nfree*2; ++i) {
+					// the other threads poll the deadline separately, so pick up their timeouts
+					if (tasks[i].cancelled) { merge_timeout(*tasks[i].searcher); }
+				}
+				if (cancelled()) { return 0.0f; }
+				// add up in the same order as the serial loop, so the result is identical
+				for (int i = 0; i < nfree; ++i) {
+					total += 0.9f * tasks[i*2].score;
+					total += 0.1f * tasks[i*2 + 1].score;
+				}
+			} else {
+				// one copy for all the children: each tile is placed and then taken away again
+				Board next_state = board;
+				for (int i = 0; i < nfree; ++i) {
+					next_state.make_placement(free[i], 1);
+					total += 0.9f * do_search_maxi(next_state, p2, lookahead - 1, 0);
+					next_state.unmake_placement(free[i]);
+					if (cancelled()) { return 0.0f; }
+					next_state.make_placement(free[i], 2);
+					total += 0.1f * do_search_maxi(next_state, p4, lookahead - 1, 0);
+					next_state.unmake_placement(free[i]);
+					if (cancelled()) { return 0.0f; }
+				}
+			}
+			const float score = total / nfree;
+
+			const Info new_cached = { lookahead, probability, score };
+			cache.put(board_k, cache_loc, lookahead, new_cached);
+			return score;
+		}
+
+		float do_search_maxi(const Board &board, float probability, int lookahead, int *move) {
+			if (move) { *move = -1; }
+
+			const uint64_t board_k = pack_board_state(board);
+			if (lookahead == 0 || probability < min_probability) {
+				if (cancelled()) { return 0.0f; }
+				if (lookahead) { tally_cutoff(lookahead); }
+				return (float)eval_board(board, board_k);
+			}
+
+			void * const cache_loc = cache.where(board_k);
+			const Info * const cached = cache.get(board_k, cache_loc, lookahead);
+			if (cache_usable(cached, probability, lookahead) && !move) {
+				tally_cache_hit(lookahead);
+				return cached->score;
+			}
+
+			// a lost position scores as badly as possible
+			float best_score = (float)eval_min_score();
+			bool have_move = false;
+			Board next_state;
+			for (int i = 0; i < 4; ++i) {
+				next_state = board;
+				if (!next_state.tilt(DIR_DX[i], DIR_DY[i])) { continue; } // ignore null moves
+				tally_move();
+				const float score = do_search_chance(next_state, probability, lookahead - 1);
+				if (cancelled()) { return 0.0f; }
+				if (!have_move || score > best_score) {
+					best_score = score;
+					have_move = true;
+					if (move) { *move = i; }
+				}
+			}
+
+			const Info new_cached = { lookahead, probability, best_score };
+			cache.put(board_k, cache_loc, lookahead, new_cached);
+			return best_score;
+		}
+
+		void begin() {
+			memset(num_cached, 0, sizeof(num_cached));
+			memset(num_cutoff, 0, sizeof(num_cutoff));
+			// cached scores depend on the evaluator and the probability cutoff they were found with
+			if (!keep_cache || evaluator().fn != cache_evalfn || min_probability != cache_min_probability) {
+				cache.reset();
+				cache_evalfn = evaluator().fn;
+				cache_min_probability = min_probability;
+			}
+		}
+
+		virtual double do_search_afterstate(const Board &board, const RNG& /*rng*/, int lookahead) {
+			begin();
+			return do_search_chance(board, 1.0f, lookahead*2 - 1);
+		}
+
+		virtual int do_search(const Board &board, const RNG& /*rng*/, int lookahead, int *move) {
+			assert(lookahead >= 0);
+			begin();
+			const float score = do_search_maxi(board, 1.0f, lookahead*2, move);
+#if PRINT_CACHE_STATS
+			printf("(expectimax) expected score %f\n", score);
+			printf("(expectimax) cache hits:");
+			for (int i = 0; i < min(lookahead*2, STAT_DEPTH); ++i) { printf(" %d", num_cached[i]); }
+			printf("\n");
+			// subtrees skipped by the probability cutoff, indexed by the lookahead they had left
+			printf("(expectimax) probability cutoffs:");
+			for (int i = 0; i < min(lookahead*2, STAT_DEPTH); ++i) { printf(" %d", num_cutoff[i]); }
+			printf("\n");
+#endif
+			return (int)score;
+		}
+};
+
+// Expectimax with Star1 pruning (and optionally Star2 probing) at chance nodes.
+// Every score lies within the evaluator's [min_score, max_score] range, so once a chance node has
+// searched some of its children, the rest can only move its value so far; if that's not enough to
+// bring the value back inside the (alpha, beta) window then the remaining children are skipped.
+// Gives the same scores as SearcherExpectimax without the probability cutoff, but it's only
+// useful with an evaluator that declares tight bounds.
+class SearcherStarExpectimax : public Searcher {
+	public:
+		SearcherStarExpectimax(): probing(false) {}
+
+		// Star2: before searching the children of a chance node in full, search one move from
+		// each of them, which gives lower bounds on their scores that may prove a cutoff early.
+		// Each probe is a whole subtree, so only chance nodes that look likely to fail high
+		// (their evaluation is already at least beta) are probed. Off by default: with the
+		// monotonicity evaluator nearly all cutoffs are fail-lows, which probing can't help with;
+		// probing every chance node took the bench positions at lookahead 5 from 17.3M moves
+		// (Star1 alone) to 38.8M, for 4 extra cutoffs.
+		void set_probing(bool enabled) { probing = enabled; }
+
+		// chance node cutoffs in the last search, in total or at one lookahead
+		int get_num_star1_cuts() const { return sum_stat(num_star1); }
+		int get_num_star2_cuts() const { return sum_stat(num_star2); }
+		int get_num_star1_cuts(int lookahead) const { return num_star1[min(lookahead, (int)STAT_DEPTH - 1)]; }
+		int get_num_star2_cuts(int lookahead) const { return num_star2[min(lookahead, (int)STAT_DEPTH - 1)]; }
+
+	private:
+		enum { SCORE_UNKNOWN, SCORE_EXACT, SCORE_LOWER_BOUND, SCORE_UPPER_BOUND };
+		struct Info { int16_t lookahead; int16_t type; float score; };
+		TieredBoardCache<Info> cache;
+		enum { STAT_DEPTH = 20 };
+		int num_cached[STAT_DEPTH];
+		int num_pruned[STAT_DEPTH];
+		int num_star1[STAT_DEPTH];
+		int num_star2[STAT_DEPTH];
+		bool probing;
+		float lo, hi;
+
+		static int sum_stat(const int *stat) {
+			int total = 0;
+			for (int i = 0; i < STAT_DEPTH; ++i) { total += stat[i]; }
+			return total;
+		}
+
+		static void tally(int *stat, int lookahead) {
+			++stat[min(lookahead, STAT_DEPTH - 1)];
+		}
+
+		bool check_cached(const Info * const cached, float alpha, float beta, int lookahead, float &output) {
+			bool cache_valid = false;
+			if (cached && cached->lookahead == lookahead) {
+				switch (cached->type) {
+					case SCORE_EXACT: cache_valid = true; break;
+					case SCORE_UPPER_BOUND: cache_valid = (cached->score <= alpha); break;
+					case SCORE_LOWER_BOUND: cache_valid = (cached->score >= beta); break;
+				}
+			}
+			if (cache_valid) {
+				tally(num_cached, lookahead);
+				output = cached->score;
+			}
+			return cache_valid;
+		}
+
+		float store(const uint64_t board_k, void *cache_loc, int lookahead, int type, float score) {
+			const Info new_cached = { (int16_t)lookahead, (int16_t)type, score };
+			cache.put(board_k, cache_loc, lookahead, new_cached);
+			return score;
+		}
+
+		// Star2 probe: the score of the first legal move from a max node is a lower bound on its score
+		float probe_maxi(const Board &board, float beta, int lookahead) {
+			Board next_state;
+			for (int i = 0; i < 4; ++i) {
+				next_state = board;
+				if (!next_state.tilt(DIR_DX[i], DIR_DY[i])) { continue; } // ignore null moves
+				tally_move();
+				return do_search_chance(next_state, lo, beta, lookahead - 1);
+			}
+			return lo;
+		}
+
+		float do_search_chance(const Board &board, float alpha, float beta, int lookahead) {
+			if (alpha >= hi) { return hi; }
+			if (beta <= lo) { return lo; }
+
+			const uint64_t board_k = pack_board_state(board);
+			void * const cache_loc = cache.where(board_k);
+			const Info * const cached = cache.get(board_k, cache_loc, lookahead);
+			float cache_output;
+			if (check_cached(cached, alpha, beta, lookahead, cache_output)) { return cache_output; }
+
+			uint8_t free[NUM_TILES];
+			const int nfree = board.count_free(free);
+			assert(nfree > 0); // a move that changes the board always leaves a free cell
+			const int nchildren = nfree * 2;
+
+			// child k places a 2 (if k is even) or a 4 (if k is odd) in cell free[k/2]
+			float probability[NUM_TILES * 2];
+			float lower[NUM_TILES * 2];
+			for (int k = 0; k < nchildren; ++k) {
+				probability[k] = ((k & 1) ? 0.1f : 0.9f) / nfree;
+				lower[k] = lo;
+			}
+			// sum of probability * lower bound, over all children
+			float lower_sum = lo;
+
+			// one copy for all the children: each tile is placed and then taken away again
+			Board next_state = board;
+			if (probing && lookahead >= 3 && beta < hi && eval_board(board, board_k) >= beta) {
+				for (int k = 0; k < nchildren; ++k) {
+					const float p = probability[k];
+					// a probe score at least this high proves a cutoff
+					const float cutoff_score = (beta - (lower_sum - p*lo)) / p;
+					const float probe_beta = min(cutoff_score, hi);
+					if (!(lo < probe_beta)) { continue; }
+					next_state.make_placement(free[k/2], 1 + (k & 1));
+					const float score = probe_maxi(next_state, probe_beta, lookahead - 1);
+					next_state.unmake_placement(free[k/2]);
+					if (cancelled()) { return lo; }
+					lower[k] = max(score, lo);
+					lower_sum += p * (lower[k] - lo);
+					if (score >= cutoff_score) {
+						tally(num_star2, lookahead);
+						return store(board_k, cache_loc, lookahead, SCORE_LOWER_BOUND, lower_sum);
+					}
+				}
+			}
+
+			float sum = 0.0f;
+			float remaining = 1.0f;
+			float remaining_lower = lower_sum;
+			for (int k = 0; k < nchildren; ++k) {
+				const float p = probability[k];
+				remaining -= p;
+				remaining_lower -= p * lower[k];
+
+				// child scores outside this window would take this node's score outside (alpha, beta)
+				float child_alpha = max((alpha - sum - remaining*hi) / p, lo);
+				float child_beta = min((beta - sum - remaining_lower) / p, hi);
+				if (!(child_alpha < child_beta)) {
+					// the window can be empty after clamping to (lo, hi): when even a child score of
+					// hi can't lift this node above alpha, or even lo can't keep it below beta (and,
+					// rarely, through rounding error); a full window still gives the right answer
+					child_alpha = lo;
+					child_beta = hi;
+				}
+
+				next_state.make_placement(free[k/2], 1 + (k & 1));
+				const float score = do_search_maxi(next_state, child_alpha, child_beta, lookahead - 1, 0);
+				next_state.unmake_placement(free[k/2]);
+				if (cancelled()) { return lo; }
+				sum += p * score;
+
+				if (score <= child_alpha && child_alpha > lo) {
+					tally(num_star1, lookahead);
+					return store(board_k, cache_loc, lookahead, SCORE_UPPER_BOUND, sum + remaining*hi);
+				}
+				if (score >= child_beta && child_beta < hi) {
+					tally(num_star1, lookahead);
+					return store(board_k, cache_loc, lookahead, SCORE_LOWER_BOUND, sum + remaining_lower);
+				}
+			}
+
+			return store(board_k, cache_loc, lookahead, SCORE_EXACT, sum);
+		}
+
+		float do_search_maxi(const Board &board, float alpha, float beta, int lookahead, int *move) {
+			if (move) { *move = -1; }
+			assert(alpha < beta);
+
+			const uint64_t board_k = pack_board_state(board);
+			if (lookahead == 0) {
+				if (cancelled()) { return lo; }
+				return (float)eval_board(board, board_k);
+			}
+
+			void * const cache_loc = cache.where(board_k);
+			const Info * const cached = cache.get(board_k, cache_loc, lookahead);
+			float cache_output;
+			if (!move && check_cached(cached, alpha, beta, lookahead, cache_output)) { return cache_output; }
+
+			// a lost position scores as badly as possible
+			float best_score = lo;
+			float best_alpha = alpha;
+			bool have_move = false;
+			Board next_state;
+			for (int i = 0; i < 4; ++i) {
+				next_state = board;
+				if (!next_state.tilt(DIR_DX[i], DIR_DY[i])) { continue; } // ignore null moves
+				tally_move();
+				const float score = do_search_chance(next_state, best_alpha, beta, lookahead - 1);
+				if (cancelled()) { return lo; }
+				if (!have_move || score > best_score) {
+					best_score = score;
+					have_move = true;
+					if (move) { *move = i; }
+				}
+				best_alpha = max(best_alpha, best_score);
+				if (best_alpha >= beta) {
+					tally(num_pruned, lookahead);
+					break;
+				}
+			}
+
+			const int type = (best_score <= alpha ? SCORE_UPPER_BOUND :
+					(best_score >= beta ? SCORE_LOWER_BOUND : SCORE_EXACT));
+			return store(board_k, cache_loc, lookahead, type, best_score);
+		}
+
+		void begin() {
+			memset(num_cached, 0, sizeof(num_cached));
+			memset(num_pruned, 0, sizeof(num_pruned));
+			memset(num_star1, 0, sizeof(num_star1));
+			memset(num_star2, 0, sizeof(num_star2));
+			lo = (float)eval_min_score();
+			hi = (float)eval_max_score();
+			assert(lo < hi);
+			cache.reset();
+		}
+
+		virtual double do_search_afterstate(const Board &board, const RNG& /*rng*/, int lookahead) {
+			begin();
+			return do_search_chance(board, -FLT_MAX, FLT_MAX, lookahead*2 - 1);
+		}
+
+		virtual int do_search(const Board &board, const RNG& /*rng*/, int lookahead, int *move) {
+			assert(lookahead >= 0);
+			begin();
+			const float score = do_search_maxi(board, -FLT_MAX, FLT_MAX, lookahead*2, move);
+#if PRINT_CACHE_STATS
+			printf("(star-expectimax) expected score %f\n", score);
+			printf("(star-expectimax) cache hits:");
+			for (int i = 0; i < min(lookahead*2, STAT_DEPTH); ++i) { printf(" %d", num_cached[i]); }
+			printf("\n(star-expectimax) max node cutoffs:");
+			for (int i = 0; i < min(lookahead*2, STAT_DEPTH); ++i) { printf(" %d", num_pruned[i]); }
+			printf("\n(star-expectimax) star1 cutoffs:");
+			for (int i = 0; i < min(lookahead*2, STAT_DEPTH); ++i) { printf(" %d", num_star1[i]); }
+			printf("\n(star-expectimax) star2 cutoffs:");
+			for (int i = 0; i < min(lookahead*2, STAT_DEPTH); ++i) { printf(" %d", num_star2[i]); }
+			printf("\n");
+#endif
+			return (int)score;
+		}
+};
+
+// Monte Carlo Tree Search: builds a tree of positions by running simulated games from the root.
+// Each simulation walks down the tree choosing moves by UCT (the move with the best balance
+// between a high average score and few visits so far) and new tiles by sampling them (so chance
+// nodes are visited in proportion to their probability), adds one new position to the tree, and
+// then plays a short rollout of random moves and scores the position that it reaches.
+// The search is anytime: a larger lookahead just runs more simulations (4x per step, to suit
+// iterative deepening), and a search of the same root as the last one continues the same tree;
+// a search of a position that's in the last tree (eg, after the move that the last search chose
+// and the new tile) keeps the subtree below that position and carries on from there.
+// The tree's nodes come from a pool allocated up front; once it's full the tree stops growing,
+// but simulations still refine the statistics of the nodes it already has.
+class SearcherMCTS : public Searcher {
+	public:
+		SearcherMCTS():
+			nodes(0), remap(0), num_nodes(0), root_k(0), root_evalfn(0),
+			exploration(0.5), rollout_length(2), base_simulations(64), reuse_tree(true),
+			bounded(false), lo(0.0), hi(0.0) {
+			nodes = static_cast<Node*>(calloc(MAX_NODES, sizeof(Node)));
+			remap = static_cast<int*>(calloc(MAX_NODES, sizeof(int)));
+		}
+
+		~SearcherMCTS() {
+			free(remap);
+			free(nodes);
+		}
+
+		// weight of the exploration term in UCT (relative to average scores, which are scaled to
+		// lie between 0 and 1)
+		void set_exploration(double c) { assert(c >= 0.0); exploration = c; }
+
+		// number of random moves made by each rollout (with 0, new positions are just evaluated)
+		void set_rollout_length(int n) { assert(n >= 0); rollout_length = n; }
+
+		// number of simulations that a search with lookahead 1 runs
+		void set_simulations(int n) { assert(n > 0); base_simulations = n; }
+
+		// keep the part of the tree below the new root (if the new root is in the tree); on by default
+		void set_tree_reuse(bool reuse) { reuse_tree = reuse; }
+
+		// number of simulations run through the current tree, and the number of nodes in it
+		int get_num_simulations() const { return (num_nodes ? nodes[0].visits : 0); }
+		int get_num_nodes() const { return num_nodes; }
+
+	private:
+		enum {
+			MAX_NODES = (1 << 18),
+			MAX_TREE_DEPTH = 64, // counting both decision nodes and chance nodes
+			NO_NODE = -1
+		};
+
+		// decision nodes (the player is to move) and chance nodes (a new tile is to be placed)
+		// alternate; a node's children form a linked list, and index is the move or placement
+		// (cell*2 for a 2, cell*2 + 1 for a 4) that leads to the child from its parent
+		struct Node {
+			int first_child;
+			int next_sibling;
+			int visits;
+			int8_t index;
+			bool expanded; // an expanded decision node with no children is a lost position
+			double total; // the sum of the scores of the simulations through this node
+		};
+
+		Node *nodes;
+		int *remap; // (for moving a subtree to the front of the pool)
+		int num_nodes;
+		uint64_t root_k;
+		EvalFn root_evalfn;
+		Board root_board;
+		RNG sim_rng;
+		double exploration;
+		int rollout_length;
+		int base_simulations;
+		bool reuse_tree;
+		// scores are scaled into [0, 1] for UCT using the evaluator's range if it has one, and
+		// otherwise the range of the scores seen so far
+		bool bounded;
+		double lo;
+		double hi;
+
+		void reset_tree(const Board &board) {
+			num_nodes = 0;
+			root_k = pack_board_state(board);
+			root_evalfn = evaluator().fn;
+			root_board = board;
+			sim_rng.reset();
+			bounded = (eval_min_score() > INT_MIN && eval_max_score() < INT_MAX);
+			lo = (bounded ? (double)eval_min_score() : DBL_MAX);
+			hi = (bounded ? (double)eval_max_score() : -DBL_MAX);
+			new_node(NO_NODE, -1);
+			expand(0, board);
+		}
+
+		// finds the decision node for a position two plies below the root (after a move and a
+		// new tile), and makes it the root, throwing away the rest of the tree; false if the
+		// position isn't in the tree
+		bool reroot(const Board &board) {
+			const uint64_t k = pack_board_state(board);
+			int found = NO_NODE;
+			for (int chance = nodes[0].first_child; chance != NO_NODE && found == NO_NODE; chance = nodes[chance].next_sibling) {
+				Board after = root_board;
+				after.tilt(DIR_DX[nodes[chance].index], DIR_DY[nodes[chance].index]);
+				for (int child = nodes[chance].first_child; child != NO_NODE; child = nodes[child].next_sibling) {
+					const int placement = nodes[child].index;
+					if (after.state[placement / 2]) { continue; }
+					after.state[placement / 2] = (placement & 1) + 1;
+					const bool match = (pack_board_state(after) == k);
+					after.state[placement / 2] = 0;
+					if (match) {
+						found = child;
+						break;
+					}
+				}
+			}
+			if (found == NO_NODE) { return false; }
+
+			// children are always created after their parents, so one pass in pool order finds the
+			// whole subtree, and moving its nodes down the pool (in the same order) is safe
+			for (int i = 0; i < num_nodes; ++i) { remap[i] = NO_NODE; }
+			remap[found] = 0;
+			for (int i = found; i < num_nodes; ++i) {
+				if (remap[i] == NO_NODE) { continue; }
+				for (int child = nodes[i].first_child; child != NO_NODE; child = nodes[child].next_sibling) {
+					remap[child] = 0;
+				}
+			}
+			int n = 0;
+			for (int i = found; i < num_nodes; ++i) {
+				if (remap[i] != NO_NODE) { remap[i] = n++; }
+			}
+			for (int i = found; i < num_nodes; ++i) {
+				if (remap[i] == NO_NODE) { continue; }
+				Node node = nodes[i];
+				if (node.first_child != NO_NODE) { node.first_child = remap[node.first_child]; }
+				node.next_sibling = (i == found || node.next_sibling == NO_NODE ? NO_NODE : remap[node.next_sibling]);
+				nodes[remap[i]] = node;
+			}
+			num_nodes = n;
+			root_k = k;
+			root_board = board;
+			if (!nodes[0].expanded) { expand(0, board); }
+			return true;
+		}
+
+		int new_node(int parent, int index) {
+			if (num_nodes == MAX_NODES) { return NO_NODE; }
+			const int i = num_nodes++;
+			Node &node = nodes[i];
+			node.first_child = NO_NODE;
+			node.next_sibling = (parent == NO_NODE ? NO_NODE : nodes[parent].first_child);
+			node.visits = 0;
+			node.index = (int8_t)index;
+			node.expanded = false;
+			node.total = 0.0;
+			if (parent != NO_NODE) { nodes[parent].first_child = i; }
+			return i;
+		}
+
+		// adds a chance node for each legal move, if there's room for all of them
+		void expand(int node, const Board &board) {
+			if (num_nodes > MAX_NODES - 4) { return; }
+			Board next_state;
+			for (int i = 0; i < 4; ++i) {
+				next_state = board;
+				if (next_state.tilt(DIR_DX[i], DIR_DY[i])) { new_node(node, i); }
+			}
+			nodes[node].expanded = true;
+		}
+
+		int find_child(int node, int index) const {
+			int child = nodes[node].first_child;
+			while (child != NO_NODE && nodes[child].index != index) { child = nodes[child].next_sibling; }
+			return child;
+		}
+
+		double scaled(double score) const {
+			return (hi > lo ? (score - lo) / (hi - lo) : 0.5);
+		}
+
+		int select_child(int node) const {
+			const double log_visits = log((double)nodes[node].visits);
+			int best = NO_NODE;
+			double best_value = -DBL_MAX;
+			for (int child = nodes[node].first_child; child != NO_NODE; child = nodes[child].next_sibling) {
+				const Node &c = nodes[child];
+				if (c.visits == 0) { return child; } // try every move once before comparing them
+				const double value = scaled(c.total / c.visits) + exploration * sqrt(log_visits / c.visits);
+				if (value > best_value) {
+					best_value = value;
+					best = child;
+				}
+			}
+			return best;
+		}
+
+		// picks a placement with the same probabilities as Board::place()
+		int sample_placement(const Board &board) {
+			uint8_t free[NUM_TILES];
+			const int nfree = board.count_free(free);
+			assert(nfree > 0); // a move that changes the board always leaves a free cell
+			const int value = (sim_rng.next_n(10) < 9 ? 1 : 2);
+			return free[sim_rng.next_n(nfree)]*2 + (value - 1);
+		}
+
+		double lost_score() const {
+			return (lo <= hi ? lo : 0.0);
+		}
+
+		double score_board(const Board &board) {
+			const double score = (double)eval_board(board);
+			if (!bounded) {
+				lo = min(lo, score);
+				hi = max(hi, score);
+			}
+			return score;
+		}
+
+		// plays random moves (on the fast path: no animation, no score keeping)
+		double rollout(Board &board) {
+			for (int i = 0; i < rollout_length; ++i) {
+				int tried = 0;
+				while (true) {
+					if (tried == 15) { return lost_score(); }
+					const int dir = sim_rng.next_n(4);
+					if (tried & (1 << dir)) { continue; }
+					tried |= (1 << dir);
+					if (board.move(dir, 0, sim_rng, 0)) { break; }
+				}
+				tally_move();
+			}
+			return score_board(board);
+		}
+
+		void simulate() {
+			int path[MAX_TREE_DEPTH + 1];
+			int depth = 0;
+			Board board = root_board;
+			int node = 0;
+			path[depth++] = node;
+			double score;
+			while (true) {
+				// decision node: a new leaf is only expanded once a simulation comes back to it
+				if (!nodes[node].expanded && nodes[node].visits > 0) { expand(node, board); }
+				if (!nodes[node].expanded || depth + 2 > MAX_TREE_DEPTH) {
+					score = rollout(board);
+					break;
+				}
+				if (nodes[node].first_child == NO_NODE) {
+					score = lost_score();
+					break;
+				}
+
+				const int chance = select_child(node);
+				const int dir = nodes[chance].index;
+				board.tilt(DIR_DX[dir], DIR_DY[dir]);
+				tally_move();
+				path[depth++] = chance;
+
+				// chance node
+				const int placement = sample_placement(board);
+				board.state[placement / 2] = (placement & 1) + 1;
+				int child = find_child(chance, placement);
+				if (child == NO_NODE) {
+					child = new_node(chance, placement);
+					if (child != NO_NODE) { path[depth++] = child; }
+					score = rollout(board);
+					break;
+				}
+				path[depth++] = child;
+				node = child;
+			}
+			for (int i = 0; i < depth; ++i) {
+				++nodes[path[i]].visits;
+				nodes[path[i]].total += score;
+			}
+		}
+
+		virtual int do_search(const Board &board, const RNG& /*rng*/, int lookahead, int *move) {
+			assert(lookahead >= 0);
+			if (move) { *move = -1; }
+			if (num_nodes == 0 || evaluator().fn != root_evalfn) {
+				reset_tree(board);
+			} else if (pack_board_state(board) != root_k) {
+				if (!reuse_tree || !reroot(board)) { reset_tree(board); }
+			}
+			if (nodes[0].first_child == NO_NODE) { return eval_min_score(); } // no legal moves
+
+			const int target = base_simulations << (2 * min(max(lookahead, 1) - 1, 10));
+			bool stopped = false;
+			while (nodes[0].visits < target) {
+				if (cancelled()) {
+					stopped = true;
+					break;
+				}
+				simulate();
+			}
+
+			// the most visited move is the most reliable; its average is its expected score
+			// (even if the search was stopped, every simulation so far has been used)
+			int best = NO_NODE;
+			for (int child = nodes[0].first_child; child != NO_NODE; child = nodes[child].next_sibling) {
+				if (best == NO_NODE || nodes[child].visits > nodes[best].visits) { best = child; }
+			}
+			if (move && nodes[best].visits > 0) { *move = nodes[best].index; }
+			if (stopped) { return INT_MIN; }
+#if PRINT_SEARCH_STATS
+			printf("(mcts) %d simulations; %d nodes; move visits:", nodes[0].visits, num_nodes);
+			for (int child = nodes[0].first_child; child != NO_NODE; child = nodes[child].next_sibling) {
+				printf(" %d:%d", nodes[child].index, nodes[child].visits);
+			}
+			printf("\n");
+#endif
+			return (int)(nodes[best].total / nodes[best].visits);
+		}
+};
+
+// Pure Monte Carlo: plays random games from the position after each legal first move, all the
+// way to the end, and picks the move with the best average game score (points from merges, as
+// in the real game; the evaluator isn't used). Cheap and embarrassingly parallel: the playouts
+// for all the moves are handed out to the threads in batches, from one shared counter.
+// Each playout has its own random seed (from its move and its number), so the results don't
+// depend on the number of threads or on timing. A search with lookahead L plays
+// 16 * 4^(L-1) games per move (to suit iterative deepening), and a search of the same root as
+// the last one only plays the games that the last one didn't.
+class SearcherRollout : public Searcher {
+	public:
+		// num_threads == 0 means use one thread per hardware thread
+		explicit SearcherRollout(int num_threads = 0):
+			num_threads(num_threads), base_playouts(16), root_k(0), num_playouts(0), elapsed(0.0) {
+			if (this->num_threads <= 0) { this->num_threads = (int)tthread::thread::hardware_concurrency(); }
+			if (this->num_threads <= 0) { this->num_threads = 1; }
+			workers = new Worker[this->num_threads];
+			for (int i = 0; i < this->num_threads; ++i) { workers[i].owner = this; }
+			reset_totals();
+		}
+
+		~SearcherRollout() {
+			delete[] workers;
+		}
+
+		// number of games played from each move by a search with lookahead 1
+		void set_playouts(int n) { assert(n > 0); base_playouts = n; }
+
+		int get_num_threads() const { return num_threads; }
+
+		// average game score for each first move (-DBL_MAX for moves that weren't possible)
+		double get_move_score(int dir) const {
+			assert(dir >= 0 && dir < 4);
+			return (legal[dir] && played > 0 ? (double)totals[dir] / played : -DBL_MAX);
+		}
+
+		// number of games played by the last search, and how many that comes to per second
+		int get_num_playouts() const { return num_playouts; }
+		double get_playouts_per_second() const { return (elapsed > 0.0 ? num_playouts / elapsed : 0.0); }
+
+	private:
+		enum { BATCH_SIZE = 32 };
+		struct Worker {
+			SearcherRollout *owner;
+			int64_t totals[4];
+			int counts[4];
+			int games;
+			int moves;
+		};
+		Worker *workers;
+		int num_threads;
+		int base_playouts;
+		// the batches for the current search: batch b plays games first + (b / num_legal)*BATCH_SIZE
+		// onwards from move moves[b % num_legal]
+		Board root;
+		uint64_t root_k;
+		int moves[4];
+		int num_legal;
+		int first;
+		int target;
+		mint_atomic32_t next_batch;
+		mint_atomic32_t stop;
+		// results of every game played from the current root so far
+		bool legal[4];
+		int64_t totals[4];
+		int played; // games played from each legal move
+		int num_playouts;
+		double elapsed;
+
+		void reset_totals() {
+			root_k = 0;
+			played = 0;
+			for (int i = 0; i < 4; ++i) {
+				legal[i] = false;
+				totals[i] = 0;
+			}
+		}
+
+		// plays one random game to the end (on the fast path: no animation), and returns its score
+		static int playout(const Board &start, int dir, int game, int &moves) {
+			RNG rng;
+			rng.reset((uint32_t)mix64(((uint64_t)dir << 32) | (uint32_t)game));
+			Board board = start;
+			int score = 0;
+			board.move(dir, 0, rng, &score);
+			while (true) {
+				int tried = 0;
+				while (true) {
+					if (tried == 15) { return score; } // game over
+					const int d = rng.next_n(4);
+					if (tried & (1 << d)) { continue; }
+					tried |= (1 << d);
+					if (board.move(d, 0, rng, &score)) { break; }
+				}
+				++moves;
+			}
+		}
+
+		// runs batches until they run out (or the search is stopped); thread 0 is the calling
+		// thread, which also watches for cancellation and the deadline on behalf of the others
+		void work(Worker &worker, bool poll) {
+			const int batches_per_move = (target - first + BATCH_SIZE - 1) / BATCH_SIZE;
+			const int num_batches = batches_per_move * num_legal;
+			while (true) {
+				const int b = (int)mint_fetch_add_32_relaxed(&next_batch, 1);
+				if (b >= num_batches) { break; }
+				const int dir = moves[b % num_legal];
+				const int begin = first + (b / num_legal) * BATCH_SIZE;
+				const int end = min(begin + BATCH_SIZE, target);
+				for (int game = begin; game < end; ++game) {
+					if (mint_load_32_relaxed(&stop) != 0) { return; }
+					if (poll && cancelled()) {
+						mint_store_32_relaxed(&stop, 1);
+						return;
+					}
+					worker.totals[dir] += playout(root, dir, game, worker.moves);
+					++worker.counts[dir];
+					++worker.games;
+				}
+			}
+		}
+
+		static void worker_main(void *data) {
+			Worker &worker = *static_cast<Worker*>(data);
+			worker.owner->work(worker, false);
+		}
+
+		virtual int do_search(const Board &board, const RNG& /*rng*/, int lookahead, int *move) {
+			assert(lookahead >= 0);
+			if (move) { *move = -1; }
+			const double start = get_time();
+			num_playouts = 0;
+			elapsed = 0.0;
+
+			if (pack_board_state(board) != root_k) {
+				reset_totals();
+				root = board;
+				root_k = pack_board_state(board);
+				for (int i = 0; i < 4; ++i) {
+					Board next_state = board;
+					legal[i] = next_state.tilt(DIR_DX[i], DIR_DY[i]);
+				}
+			}
+			num_legal = 0;
+			for (int i = 0; i < 4; ++i) {
+				if (legal[i]) { moves[num_legal++] = i; }
+			}
+			if (num_legal == 0) { return INT_MIN; } // a lost position
+			tally_moves(num_legal);
+
+			first = played;
+			target = max(played, base_playouts << (2 * min(max(lookahead, 1) - 1, 10)));
+			next_batch._nonatomic = 0;
+			stop._nonatomic = 0;
+			for (int i = 0; i < num_threads; ++i) {
+				Worker &worker = workers[i];
+				for (int j = 0; j < 4; ++j) {
+					worker.totals[j] = 0;
+					worker.counts[j] = 0;
+				}
+				worker.games = 0;
+				worker.moves = 0;
+			}
+			tthread::thread **threads = new tthread::thread*[num_threads];
+			threads[0] = 0;
+			for (int i = 1; i < num_threads; ++i) {
+				threads[i] = new tthread::thread(&worker_main, &workers[i]);
+			}
+			work(workers[0], true);
+			for (int i = 0; i < num_threads; ++i) {
+				if (threads[i]) {
+					threads[i]->join();
+					delete threads[i];
+				}
+				tally_moves(workers[i].moves);
+				num_playouts += workers[i].games;
+				for (int j = 0; j < 4; ++j) { totals[j] += workers[i].totals[j]; }
+			}
+			delete[] threads;
+			elapsed = get_time() - start;
+			if (mint_load_32_relaxed(&stop) != 0) {
+				// some batches never ran, so the moves have had different numbers of games;
+				// the best average so far is still worth having, but the totals can't be continued
+				int counts[4] = {0, 0, 0, 0};
+				for (int i = 0; i < num_threads; ++i) {
+					for (int j = 0; j < 4; ++j) { counts[j] += workers[i].counts[j]; }
+				}
+				int best = -1;
+				double best_average = 0.0;
+				for (int i = 0; i < 4; ++i) {
+					if (!legal[i] || played + counts[i] == 0) { continue; }
+					const double average = (double)totals[i] / (played + counts[i]);
+					if (best < 0 || average > best_average) {
+						best = i;
+						best_average = average;
+					}
+				}
+				if (move) { *move = best; }
+				reset_totals();
+				return INT_MIN;
+			}
+			played = target;
+
+			int best = -1;
+			for (int i = 0; i < 4; ++i) {
+				if (legal[i] && (best < 0 || totals[i] > totals[best])) { best = i; }
+			}
+			if (move) { *move = best; }
+#if PRINT_SEARCH_STATS
+			printf("(rollout) %d games per move on %d threads (%.0f games per second); average scores %f %f %f %f\n",
+					played, num_threads, get_playouts_per_second(),
+					get_move_score(0), get_move_score(1), get_move_score(2), get_move_score(3));
+#endif
+			return (int)(totals[best] / played);
+		}
+};
+
+// Root-parallel search: each legal first move is searched on its own thread, by its own instance
+// of S (which must support afterstate searches), and then the results are merged. The threads
+// share nothing, so they never contend with each other, but they can't share cached results either.
+template <typename S>
+class SearcherRootSplit : public Searcher {
+	public:
+		SearcherRootSplit(): wall_time(0.0), thread_time(0.0) {
+			for (int i = 0; i < 4; ++i) {
+				workers[i].owner = this;
+				workers[i].searcher.set_master(this);
+			}
+		}
+
+		// score of each first move in the last search (-DBL_MAX for moves that weren't possible)
+		double get_move_score(int dir) const {
+			assert(dir >= 0 && dir < 4);
+			return workers[dir].score;
+		}
+
+		// total CPU time used by the worker threads in the last search, relative to the time the
+		// search took; ie, the average number of cores kept busy (this isn't a speed-up: a serial
+		// search doesn't have the overhead of separate caches; the bench measures that)
+		double get_utilisation() const { return (wall_time > 0.0 ? thread_time / wall_time : 1.0); }
+
+	private:
+		struct Worker {
+			SearcherRootSplit *owner;
+			S searcher;
+			Board board;
+			RNG rng;
+			int lookahead;
+			double score;
+			double elapsed;
+		};
+		Worker workers[4];
+		double wall_time;
+		double thread_time;
+
+		static void worker_main(void *data) {
+			Worker &worker = *static_cast<Worker*>(data);
+			const double start = get_thread_time();
+			worker.score = worker.searcher.search_afterstate(
+					worker.owner->evaluator(), worker.board, worker.rng, worker.lookahead);
+			worker.elapsed = get_thread_time() - start;
+		}
+
+		virtual int do_search(const Board &board, const RNG &rng, int lookahead, int *move) {
+			assert(lookahead >= 0);
+			if (move) { *move = -1; }
+			if (lookahead == 0) { return eval_board(board); }
+
+			const double start = get_time();
+			tthread::thread *threads[4];
+			for (int i = 0; i < 4; ++i) {
+				Worker &worker = workers[i];
+				worker.board = board;
+				worker.rng = rng;
+				worker.lookahead = lookahead;
+				worker.score = -DBL_MAX;
+				worker.elapsed = 0.0;
+				threads[i] = 0;
+				if (!worker.board.tilt(DIR_DX[i], DIR_DY[i])) { continue; } // ignore null moves
+				tally_move();
+				threads[i] = new tthread::thread(&worker_main, &worker);
+			}
+
+			thread_time = 0.0;
+			for (int i = 0; i < 4; ++i) {
+				if (!threads[i]) { continue; }
+				threads[i]->join();
+				delete threads[i];
+				tally_moves(workers[i].searcher.get_num_moves());
+				merge_timeout(workers[i].searcher);
+				thread_time += workers[i].elapsed;
+			}
+			wall_time = get_time() - start;
+			const bool stopped = cancelled();
+
+			double best_score = (double)INT_MIN;
+			for (int i = 0; i < 4; ++i) {
+				if (!threads[i]) { continue; }
+				// if the search was stopped, only the moves whose searches finished count
+				if (stopped && workers[i].searcher.get_completed_lookahead() != lookahead) { continue; }
+				if (workers[i].score > best_score) {
+					best_score = workers[i].score;
+					if (move) { *move = i; }
+				}
+			}
+			if (stopped) { return INT_MIN; }
+#if PRINT_SEARCH_STATS
+			printf("(root-split) move scores: %f %f %f %f; utilisation %.2f\n",
+					workers[0].score, workers[1].score, workers[2].score, workers[3].score, get_utilisation());
+#endif
+			return (int)best_score;
+		}
+};
+
+// Lazy SMP: a group of threads all search the same position, each with its own instance of S,
+// but sharing one cache, so that each thread can make use of subtrees the others have finished.
+// To stop the threads all following each other through the tree, they try moves in different
+// orders, and every other thread searches one ply deeper. The first thread to finish (at the
+// requested lookahead or deeper) reports its result, and the rest are stopped.
+// S must support share_cache() and set_move_order().
+template <typename S>
+class SearcherLazySMP : public Searcher {
+	public:
+		// num_threads == 0 means use one thread per hardware thread
+		explicit SearcherLazySMP(int num_threads = 0):
+			num_workers(num_threads), winner(-1), shared_evalfn(0) {
+			if (num_workers <= 0) { num_workers = (int)tthread::thread::hardware_concurrency(); }
+			if (num_workers <= 0) { num_workers = 1; }
+			workers = new Worker[num_workers];
+			for (int i = 0; i < num_workers; ++i) {
+				Worker &worker = workers[i];
+				worker.owner = this;
+				worker.searcher.set_master(this);
+				worker.searcher.set_stop_flag(&finished);
+				worker.searcher.share_cache(&shared);
+				worker.searcher.set_move_order(i / 2);
+				worker.extra_lookahead = (i & 1);
+			}
+		}
+
+		~SearcherLazySMP() {
+			delete[] workers;
+		}
+
+		int get_num_threads() const { return num_workers; }
+
+		// index of the thread whose result was used in the last search (-1 if none finished)
+		int get_winner() const { return winner; }
+
+	private:
+		struct Worker {
+			SearcherLazySMP *owner;
+			S searcher;
+			Board board;
+			RNG rng;
+			int lookahead;
+			int extra_lookahead;
+			int score;
+			int move;
+		};
+		Worker *workers;
+		int num_workers;
+		int winner;
+		mint_atomic32_t finished;
+		typename S::SharedCache shared;
+		EvalFn shared_evalfn;
+
+		// cached scores stay valid between searches, as long as the evaluator doesn't change
+		virtual void do_prepare(const Evaluator &evalfn) {
+			if (evalfn.fn != shared_evalfn) {
+				shared.reset();
+				shared_evalfn = evalfn.fn;
+			}
+			for (int i = 0; i < num_workers; ++i) { workers[i].searcher.prepare(evalfn); }
+		}
+
+		static void worker_main(void *data) {
+			Worker &worker = *static_cast<Worker*>(data);
+			SearcherLazySMP &owner = *worker.owner;
+			const int lookahead = worker.lookahead + worker.extra_lookahead;
+			worker.score = worker.searcher.search(owner.evaluator(), worker.board, worker.rng, lookahead);
+			worker.move = worker.searcher.get_best_first_move();
+			if (worker.searcher.get_completed_lookahead() != lookahead) { return; }
+			// first to finish stops everyone else
+			if (mint_compare_exchange_strong_32_relaxed(&owner.finished, 0, 1) == 0) {
+				owner.winner = (int)(&worker - owner.workers);
+			}
+		}
+
+		virtual int do_search(const Board &board, const RNG &rng, int lookahead, int *move) {
+			assert(lookahead >= 0);
+			if (move) { *move = -1; }
+			if (lookahead == 0) { return eval_board(board); }
+
+			winner = -1;
+			finished._nonatomic = 0;
+			tthread::thread **threads = new tthread::thread*[num_workers];
+			for (int i = 0; i < num_workers; ++i) {
+				Worker &worker = workers[i];
+				worker.board = board;
+				worker.rng = rng;
+				worker.lookahead = lookahead;
+				worker.score = INT_MIN;
+				worker.move = -1;
+				// the calling thread does the work of the first worker itself
+				threads[i] = (i > 0 ? new tthread::thread(&worker_main, &worker) : 0);
+			}
+			worker_main(&workers[0]);
+			for (int i = 0; i < num_workers; ++i) {
+				if (threads[i]) {
+					threads[i]->join();
+					delete threads[i];
+				}
+				tally_moves(workers[i].searcher.get_num_moves());
+				merge_timeout(workers[i].searcher);
+			}
+			delete[] threads;
+
+			if (cancelled() || winner < 0) {
+				// nobody finished, but the first thread's best move so far is still worth having
+				if (move) { *move = workers[0].move; }
+				return INT_MIN;
+			}
+#if PRINT_SEARCH_STATS
+			printf("(lazy-smp) thread %d of %d finished first (lookahead %d); %d moves in total\n",
+					winner, num_workers, lookahead + workers[winner].extra_lookahead, get_num_moves());
+#endif
+			if (move) { *move = workers[winner].move; }
+			return workers[winner].score;
+		}
+};
+
+// Task-parallel search: nodes near the root hand their children to a work-stealing scheduler
+// as tasks, so that a single search can keep any number of cores busy. Each thread has its own
+// instance of S (with its own private cache), and they all share one cache for deep results.
+// S must support share_cache(), join_team() and help(); SearcherExpectimax splits chance
+// nodes, and SearcherCachingAlphaBeta splits nodes Young Brothers Wait style.
+// The scores are the same as a serial search by S, except for S's probability
+// cutoff (a cached result searched with a higher probability can stand in for one with a
+// lower probability, and which ones are found first depends on timing).
+template <typename S>
+class SearcherParallel : public Searcher {
+	public:
+		// num_threads == 0 means use one thread per hardware thread
+		explicit SearcherParallel(int num_threads = 0):
+			num_threads(num_threads), num_active(1), task_lookahead(DEFAULT_TASK_LOOKAHEAD), scheduler(0), team(0), shared_evalfn(0) {
+			if (this->num_threads <= 0) { this->num_threads = (int)tthread::thread::hardware_concurrency(); }
+			if (this->num_threads <= 0) { this->num_threads = 1; }
+			scheduler = new WorkStealingScheduler(this->num_threads);
+			team = new S*[this->num_threads];
+			helpers = new Helper[this->num_threads];
+			for (int i = 0; i < this->num_threads; ++i) {
+				team[i] = new S();
+				team[i]->set_master(this);
+				team[i]->share_cache(&shared);
+				team[i]->join_team(scheduler, team, i, task_lookahead);
+				helpers[i].owner = this;
+				helpers[i].thread = i;
+			}
+		}
+
+		~SearcherParallel() {
+			for (int i = 0; i < num_threads; ++i) { delete team[i]; }
+			delete[] helpers;
+			delete[] team;
+			delete scheduler;
+		}
+
+		// (SearcherExpectimax only)
+		void set_probability_cutoff(float p) {
+			for (int i = 0; i < num_threads; ++i) { team[i]->set_probability_cutoff(p); }
+		}
+
+		// granularity: only nodes with at least this many plies to go are split into tasks;
+		// smaller subtrees are searched serially by whichever thread picked them up. Searches
+		// too shallow to reach it still split the layer below the root, and searches too
+		// shallow for that to be worth it (less than MIN_TASK_LOOKAHEAD plies below the root's
+		// children) run serially on the calling thread.
+		void set_task_lookahead(int lookahead) {
+			assert(lookahead >= 1);
+			task_lookahead = lookahead;
+		}
+
+		int get_num_threads() const { return num_threads; }
+		int get_num_steals() const { return scheduler->get_num_steals(); }
+
+		// YBWC statistics (see SearcherCachingAlphaBeta), summed over the threads used by the last search
+		int get_num_aborts() const {
+			int total = 0;
+			for (int i = 0; i < num_active; ++i) { total += team[i]->get_num_aborts(); }
+			return total;
+		}
+
+		int get_num_wasted_moves() const {
+			int total = 0;
+			for (int i = 0; i < num_active; ++i) { total += team[i]->get_num_wasted_moves(); }
+			return total;
+		}
+
+	private:
+		enum { DEFAULT_TASK_LOOKAHEAD = 5, MIN_TASK_LOOKAHEAD = 3 };
+		struct Helper {
+			SearcherParallel *owner;
+			int thread;
+		};
+		int num_threads;
+		int num_active; // the number of threads the last search ran on
+		int task_lookahead;
+		WorkStealingScheduler *scheduler;
+		S **team;
+		Helper *helpers;
+		typename S::SharedCache shared;
+		EvalFn shared_evalfn;
+
+		// cached scores stay valid between searches, as long as the evaluator doesn't change
+		virtual void do_prepare(const Evaluator &evalfn) {
+			if (evalfn.fn != shared_evalfn) {
+				shared.reset();
+				shared_evalfn = evalfn.fn;
 			}
+			for (int i = 0; i < num_threads; ++i) { team[i]->prepare(evalfn); }
 		}
 
-		virtual int do_search(const Board &board, const RNG& /*rng*/, int lookahead, int *move) {
+		static void helper_main(void *data) {
+			Helper &helper = *static_cast<Helper*>(data);
+			helper.owner->team[helper.thread]->help(helper.owner->evaluator());
+		}
+
+		virtual int do_search(const Board &board, const RNG &rng, int lookahead, int *move) {
 			assert(lookahead >= 0);
-			memset(num_cached, 0, sizeof(num_cached));
-			num_pruned = 0;
-			cache.reset();
-			int score = do_search_maxi(board, INT_MIN, INT_MAX, lookahead*2, move);
-#if PRINT_CACHE_STATS
-			printf("(caching-alpha-beta) alpha-beta pruned %d\n", num_pruned);
-			printf("(caching-alpha-beta) cache hits:");
-			for (int i = 0; i < min(lookahead*2, STAT_DEPTH); ++i) { printf(" %d", num_cached[i]); }
-			printf("\n");
+			if (move) { *move = -1; }
+			if (lookahead == 0) { return eval_board(board); }
+
+			// (lookahead counts moves; the team members count plies, and the root's children
+			// have lookahead*2 - 1 to go)
+			const int split_lookahead = min(task_lookahead, lookahead*2 - 1);
+			// (begin() resets the scheduler's statistics, even if it isn't used)
+			scheduler->begin();
+			if (split_lookahead < MIN_TASK_LOOKAHEAD) {
+				num_active = 1;
+				team[0]->join_team(scheduler, team, 0, INT_MAX);
+				const int score = team[0]->search(evaluator(), board, rng, lookahead);
+				tally_moves(team[0]->get_num_moves());
+				merge_timeout(*team[0]);
+				if (move) { *move = team[0]->get_best_first_move(); }
+				return (cancelled() ? INT_MIN : score);
+			}
+			num_active = num_threads;
+			for (int i = 0; i < num_threads; ++i) { team[i]->join_team(scheduler, team, i, split_lookahead); }
+			tthread::thread **threads = new tthread::thread*[num_threads];
+			threads[0] = 0;
+			for (int i = 1; i < num_threads; ++i) {
+				threads[i] = new tthread::thread(&helper_main, &helpers[i]);
+			}
+			// the calling thread searches the root, and spawns the first tasks
+			const int score = team[0]->search(evaluator(), board, rng, lookahead);
+			scheduler->end();
+			for (int i = 0; i < num_threads; ++i) {
+				if (threads[i]) {
+					threads[i]->join();
+					delete threads[i];
+				}
+				tally_moves(team[i]->get_num_moves());
+				merge_timeout(*team[i]);
+			}
+			delete[] threads;
+
+			// (if the search was stopped, this is the best move found so far)
+			if (move) { *move = team[0]->get_best_first_move(); }
+			if (cancelled()) { return INT_MIN; }
+#if PRINT_SEARCH_STATS
+			printf("(parallel) %d threads; %d tasks stolen; %d moves in total\n",
+					num_threads, get_num_steals(), get_num_moves());
 #endif
 			return score;
 		}
 };
 
-const SearcherCachingAlphaBeta::Info SearcherCachingAlphaBeta::Info::NIL = { -1, SCORE_UNKNOWN, INT_MIN };
-
 static int monotonicity(const uint8_t *begin, int stride, int n) {
 	int total = (n - 2);
 	int i;
@@ -1137,6 +3838,33 @@ static int ai_eval_board(const Board &board) {
 	//return board.count_free();
 }
 
+// note: if you change ai_eval_board you must update the bounds
+// (each row and column has a monotonicity score between 0 and (length - 2))
+static const Evaluator AI_EVALUATOR(&ai_eval_board, 0, TILES_Y*(TILES_X - 2) + TILES_X*(TILES_Y - 2));
+
+// Picks the (maximum) lookahead to search a position with
+typedef int (*DepthPolicyFn)(const Board &board);
+
+static int count_distinct_tiles(const Board &board) {
+	int seen = 0, distinct = 0;
+	for (int i = 0; i < NUM_TILES; ++i) {
+		if (board.state[i] && !(seen & (1 << board.state[i]))) {
+			seen |= (1 << board.state[i]);
+			++distinct;
+		}
+	}
+	return distinct;
+}
+
+static int ai_depth_policy(const Board &board) {
+	const int nfree = board.count_free();
+	// open boards are hard to lose, and their searches are the most expensive
+	if (nfree >= 6) { return 2; }
+	// crowded boards with lots of different tiles (that can't be merged soon) are where games are lost
+	if (nfree <= 2 && count_distinct_tiles(board) >= 7) { return 4; }
+	return 3;
+}
+
 // -------- AI Worker Thread -------------------------------------------------------------------
 
 class AIWorker {
@@ -1145,16 +3873,30 @@ class AIWorker {
 		~AIWorker();
 
 		void Cancel();
+		// stops the search that's been asked for early; its result is then the best move found
+		// so far (see Searcher::search_timed())
+		void Finish();
 		void Reset(); // blocks
-		void Work(const Board &board, const RNG &rng, int lookahead);
+		void Work(const Board &board, const RNG &rng, int max_lookahead, double time_budget);
+		// searches a position in the background before anyone has asked for it (eg, while the
+		// player is thinking); if Work() is then called with the same arguments, it uses the
+		// result (or joins the search in progress) instead of starting again. IsWorking() and
+		// IsDone() ignore pondering, and a call to Work() for a different position stops it.
+		void Ponder(const Board &board, const RNG &rng, int max_lookahead, double time_budget);
+		void StopPondering(); // blocks
+		// if set, the policy is consulted for each position, and the search goes no deeper than
+		// the lookahead it picks (still within the time budget, and max_lookahead)
+		void SetDepthPolicy(DepthPolicyFn policy);
 		bool IsWorking() const;
 		bool IsDone(int *move = 0) const;
 		void Wait(int *move = 0) const;
 
 	private:
-		SearcherCachingAlphaBeta m_searcher;
+		Searcher *m_searcher;
 		Evaluator m_evalfn;
+		DepthPolicyFn m_depth_policy;
 		int m_lookahead;
+		double m_time_budget;
 
 		Board m_board;
 		RNG m_rng;
@@ -1162,48 +3904,145 @@ class AIWorker {
 		tthread::thread m_thread;
 		mutable tthread::mutex m_lock;
 		mutable tthread::condition_variable m_trigger;
-		bool m_working;
+		bool m_busy; // the thread has a search to run (or is running one)
+		bool m_exiting; // the thread should return from Main() as soon as it's idle
+		bool m_cancelling; // the search is being stopped, and its result must be thrown away
+		bool m_working; // someone wants the result of the search
 		bool m_done;
 		int m_move;
+		// the result of the last search, if it finished while nobody wanted it
+		bool m_pondered;
+		int m_pondered_move;
 
+		bool IsSameSearch(const Board &board, const RNG &rng, int max_lookahead, double time_budget) const;
+		void Start(const Board &board, const RNG &rng, int max_lookahead, double time_budget);
+		void StopLocked();
 		void Main();
 		static void ai_worker_main(void *self);
 };
 
 AIWorker::AIWorker():
-	m_evalfn(&ai_eval_board),
+	m_evalfn(AI_EVALUATOR),
+	m_depth_policy(0),
 	m_lookahead(2),
-	m_working(false), m_done(false), m_move(-1) {
+	m_time_budget(0.1),
+	m_busy(false), m_exiting(false), m_cancelling(false), m_working(false), m_done(false), m_move(-1),
+	m_pondered(false), m_pondered_move(-1) {
+	// with more than one core, share each search between all of them
+	if (tthread::thread::hardware_concurrency() > 1) {
+		m_searcher = new SearcherParallel<SearcherExpectimax>();
+	} else {
+		m_searcher = new SearcherExpectimax();
+	}
 	m_thread.start(&AIWorker::ai_worker_main, this);
 }
 
-AIWorker::~AIWorker() {}
+AIWorker::~AIWorker() {
+	{
+		tthread::lock_guard<tthread::mutex> guard(m_lock);
+		StopLocked();
+		m_exiting = true;
+	}
+	m_trigger.notify_all();
+	m_thread.join();
+	delete m_searcher;
+}
+
+// (m_lock must be held) whether the last search started was (or is) for these arguments
+bool AIWorker::IsSameSearch(const Board &board, const RNG &rng, int max_lookahead, double time_budget) const {
+	return (memcmp(&board, &m_board, sizeof(Board)) == 0 && memcmp(&rng, &m_rng, sizeof(RNG)) == 0 &&
+			max_lookahead == m_lookahead && time_budget == m_time_budget);
+}
+
+// (m_lock must be held, and the thread must be idle)
+void AIWorker::Start(const Board &board, const RNG &rng, int max_lookahead, double time_budget) {
+	assert(!m_busy);
+	m_busy = true;
+	m_pondered = false;
+	m_board = board;
+	m_rng = rng;
+	m_lookahead = max_lookahead;
+	m_time_budget = time_budget;
+}
+
+// (m_lock must be held) stops the search in progress, if there is one, and waits for it to finish
+void AIWorker::StopLocked() {
+	if (!m_busy) { return; }
+	m_cancelling = true;
+	m_searcher->cancel();
+	while (m_busy) { m_trigger.wait(m_lock); }
+}
 
-void AIWorker::Work(const Board &board, const RNG &rng, int lookahead) {
+void AIWorker::Work(const Board &board, const RNG &rng, int max_lookahead, double time_budget) {
 	{
 		tthread::lock_guard<tthread::mutex> guard(m_lock);
 		if (m_working) {
 			fprintf(stderr, "AIWorker::Work() called while we're already working!\n");
 			return;
 		}
-		m_working = true;
 		m_done = false;
 		m_move = -1;
-		m_board = board;
-		m_rng = rng;
-		m_lookahead = lookahead;
+		if (IsSameSearch(board, rng, max_lookahead, time_budget)) {
+			if (m_pondered) {
+				// already searched: the result is ready straight away
+				m_pondered = false;
+				m_move = m_pondered_move;
+				m_done = true;
+				return;
+			}
+			if (m_busy && !m_cancelling) {
+				// being searched: just wait for the search to finish
+				m_working = true;
+				return;
+			}
+		}
+		StopLocked();
+		m_working = true;
+		Start(board, rng, max_lookahead, time_budget);
 	}
-	m_trigger.notify_one();
+	m_trigger.notify_all();
+}
+
+void AIWorker::Ponder(const Board &board, const RNG &rng, int max_lookahead, double time_budget) {
+	{
+		tthread::lock_guard<tthread::mutex> guard(m_lock);
+		if (m_working) { return; } // the thread is busy with something that's actually wanted
+		if ((m_pondered || (m_busy && !m_cancelling)) && IsSameSearch(board, rng, max_lookahead, time_budget)) { return; }
+		StopLocked();
+		Start(board, rng, max_lookahead, time_budget);
+	}
+	m_trigger.notify_all();
+}
+
+void AIWorker::StopPondering() {
+	tthread::lock_guard<tthread::mutex> guard(m_lock);
+	if (!m_working) { StopLocked(); }
+}
+
+void AIWorker::SetDepthPolicy(DepthPolicyFn policy) {
+	tthread::lock_guard<tthread::mutex> guard(m_lock);
+	m_depth_policy = policy;
 }
 
 void AIWorker::Cancel() {
-	m_searcher.cancel();
+	{
+		tthread::lock_guard<tthread::mutex> guard(m_lock);
+		if (m_busy) {
+			m_cancelling = true;
+			m_searcher->cancel();
+		}
+	}
 	Reset();
 }
 
+void AIWorker::Finish() {
+	tthread::lock_guard<tthread::mutex> guard(m_lock);
+	if (m_working) { m_searcher->cancel(); }
+}
+
 void AIWorker::Reset() {
 	tthread::lock_guard<tthread::mutex> guard(m_lock);
-	while (m_working) { m_trigger.wait(m_lock); }
+	while (m_busy) { m_trigger.wait(m_lock); }
 	assert(!m_working);
 	m_move = -1;
 	m_done = false;
@@ -1231,31 +4070,43 @@ void AIWorker::Main() {
 	Board board;
 	RNG rng;
 	int lookahead;
+	double time_budget;
 	while (true) {
 		{
 			tthread::lock_guard<tthread::mutex> guard(m_lock);
-			while (!m_working) {
+			while (!m_busy && !m_exiting) {
 				m_trigger.wait(m_lock);
 			}
+			if (!m_busy) { return; }
 
 			board = m_board;
 			rng = m_rng;
 			lookahead = m_lookahead;
+			time_budget = m_time_budget;
+			if (m_depth_policy) { lookahead = max(1, min(lookahead, m_depth_policy(board))); }
 		}
 
-		m_searcher.search(m_evalfn, board, rng, lookahead);
-		int move = m_searcher.get_best_first_move();
+		m_searcher->search_timed(m_evalfn, board, rng, lookahead, time_budget);
+		int move = m_searcher->get_best_first_move();
 #if 1 || PRINT_CACHE_STATS
-		printf("tried %d moves!\n", m_searcher.get_num_moves());
+		printf("tried %d moves (reached lookahead %d)!\n", m_searcher->get_num_moves(), m_searcher->get_completed_lookahead());
 #endif
 
 		{
 			tthread::lock_guard<tthread::mutex> guard(m_lock);
-			m_move = move;
-			m_done = true;
-			m_working = false;
+			if (m_working) {
+				m_move = move;
+				m_done = true;
+				m_working = false;
+			} else if (!m_cancelling) {
+				// nobody has asked for this yet; keep it in case they do
+				m_pondered = true;
+				m_pondered_move = move;
+			}
+			m_cancelling = false;
+			m_busy = false;
 		}
-		m_trigger.notify_one();
+		m_trigger.notify_all();
 	}
 }
 
@@ -1354,6 +4205,10 @@ static void render_rounded_square(float x, float y, float extent, float rounding
 static const double ANIM_SPEED_NORMAL = 1.0 * 1000.0;
 static const double ANIM_SPEED_AUTOPLAY = 2.0 * 1000.0;
 
+// the AI deepens its search until it runs out of time (in seconds) or reaches the max lookahead
+static const double AI_TIME_BUDGET = 0.1;
+static const int AI_MAX_LOOKAHEAD = 10;
+
 static const uint8_t TILE_COLORS[16][4] = {
 	{ 211, 199, 187, 255 }, // blank tile
 	{ 238, 228, 218, 255 }, //     2
@@ -1754,8 +4609,15 @@ static void start_anim(const double speed) {
 
 static void automove() {
 	assert(s_ai_worker);
-	const int lookahead = 5;
-	s_ai_worker->Work(s_history.get(), s_history.get_rng(), lookahead);
+	s_ai_worker->Work(s_history.get(), s_history.get_rng(), AI_MAX_LOOKAHEAD, AI_TIME_BUDGET);
+}
+
+// searches the current position in the background while the player thinks about their move;
+// the new tile has already been placed, so this is exactly the search that a hint would do,
+// and asking for a hint will get its result straight away
+static void ponder() {
+	assert(s_ai_worker);
+	s_ai_worker->Ponder(s_history.get(), s_history.get_rng(), AI_MAX_LOOKAHEAD, AI_TIME_BUDGET);
 }
 
 static void handle_key(GLFWwindow * /*wnd*/, int key, int /*scancode*/, int action, int /*mods*/) {
@@ -1767,9 +4629,14 @@ static void handle_key(GLFWwindow * /*wnd*/, int key, int /*scancode*/, int acti
 				if (key == GLFW_KEY_P) {
 					s_ai_worker->Cancel();
 					s_autoplay = false;
+					ponder();
 				}
 			} else {
-				if (s_ai_worker->IsWorking()) { return; }
+				if (s_ai_worker->IsWorking()) {
+					// asking for a hint again hurries up the first one
+					if (key == GLFW_KEY_H) { s_ai_worker->Finish(); }
+					return;
+				}
 
 				stop_anim();
 				switch (key) {
@@ -1784,6 +4651,8 @@ static void handle_key(GLFWwindow * /*wnd*/, int key, int /*scancode*/, int acti
 					case GLFW_KEY_P:     { s_autoplay = true; automove(); } break;
 				}
 				start_anim(ANIM_SPEED_NORMAL);
+				// (does nothing if the AI has been asked for a move)
+				ponder();
 			}
 		}
 	}
@@ -1821,7 +4690,647 @@ static void fons_error_callback(void* /*udata*/, int error, int /*val*/) {
 	}
 }
 
-int main(int /*argc*/, char** /*argv*/) {
+// Positions (from one game) for comparing searchers; see run_bench()
+static const uint64_t BENCH_POSITIONS[] = {
+	0x5330310020000000ull, 0x6543520220010100ull, 0x7653343202100000ull, 0x7653653243213110ull,
+	0x8532742052003001ull, 0x0003009421350134ull, 0x2002029113450037ull, 0x1932480005001000ull,
+	0x0035018242561913ull, 0x2320870097211010ull, 0x3a21442062004000ull, 0x3a31752153004200ull,
+	0x000010550a833221ull, 0x000011045651a854ull, 0x001010026532a876ull, 0x000032113600a963ull
+};
+static const int NUM_BENCH_POSITIONS = sizeof(BENCH_POSITIONS) / sizeof(BENCH_POSITIONS[0]);
+
+// extra statistics for the bench, summed over every search (for example, MTD(f) passes)
+typedef int (*BenchStatFn)(const Searcher &searcher);
+
+// Searches each bench position the way the AI does (iterative deepening up to lookahead) and
+// prints the total number of moves searched and the time taken. The final scores are stored in
+// scores, and if a reference is given, the number of positions where they differ is printed too.
+// If stat is given, its total is printed too (as a fraction of stat_of's total, if that's given).
+// Returns the time taken.
+static double bench_searcher(const char *name, Searcher &searcher, int lookahead, const int *reference, int *scores,
+		BenchStatFn stat = 0, const char *stat_name = 0, BenchStatFn stat_of = 0) {
+	RNG rng;
+	rng.reset();
+	long long total_moves = 0;
+	long long total_stat = 0;
+	long long total_stat_of = 0;
+	int mismatches = 0;
+	const double start = get_time();
+	for (int i = 0; i < NUM_BENCH_POSITIONS; ++i) {
+		Board board;
+		unpack_board_state(board, BENCH_POSITIONS[i]);
+		int score = INT_MIN;
+		for (int l = 1; l <= lookahead; ++l) {
+			score = searcher.search(AI_EVALUATOR, board, rng, l);
+			total_moves += searcher.get_num_moves();
+			if (stat) { total_stat += stat(searcher); }
+			if (stat_of) { total_stat_of += stat_of(searcher); }
+		}
+		scores[i] = score;
+		if (reference && reference[i] != score) { ++mismatches; }
+	}
+	const double elapsed = get_time() - start;
+	printf("%-32s %12lld moves %9.3fs", name, total_moves, elapsed);
+	if (stat && stat_of) {
+		printf("  %lld/%lld %s", total_stat, total_stat_of, stat_name);
+	} else if (stat) {
+		printf("  %lld %s", total_stat, stat_name);
+	}
+	if (reference) { printf("  (%d scores differ)", mismatches); }
+	printf("\n");
+	return elapsed;
+}
+
+static int bench_mtdf_passes(const Searcher &searcher) {
+	return static_cast<const SearcherCachingAlphaBeta&>(searcher).get_num_passes();
+}
+
+static int bench_first_moves_best(const Searcher &searcher) {
+	return static_cast<const SearcherCachingAlphaBeta&>(searcher).get_num_first_moves_best();
+}
+
+static int bench_best_moves(const Searcher &searcher) {
+	return static_cast<const SearcherCachingAlphaBeta&>(searcher).get_num_best_moves();
+}
+
+static int bench_transposition_cutoffs(const Searcher &searcher) {
+	return static_cast<const SearcherCachingAlphaBeta&>(searcher).get_num_transposition_cutoffs();
+}
+
+static int bench_board_kib(const Searcher &searcher) {
+	return (int)(static_cast<const SearcherAlphaBeta&>(searcher).get_num_board_bytes() / 1024);
+}
+
+static int bench_aspiration_fails(const Searcher &searcher) {
+	return static_cast<const SearcherCachingAlphaBeta&>(searcher).get_num_aspiration_fails();
+}
+
+// Searches the bench positions with the task-parallel caching alpha-beta searcher, like
+// bench_searcher(), and also prints the number of cutoffs that aborted sibling tasks, and the
+// number of moves searched by tasks that were aborted (ie, wasted work)
+static void bench_ybwc(SearcherParallel<SearcherCachingAlphaBeta> &searcher, int lookahead, const int *reference, int *scores) {
+	RNG rng;
+	rng.reset();
+	long long total_moves = 0;
+	long long total_aborts = 0;
+	long long total_wasted = 0;
+	int mismatches = 0;
+	const double start = get_time();
+	for (int i = 0; i < NUM_BENCH_POSITIONS; ++i) {
+		Board board;
+		unpack_board_state(board, BENCH_POSITIONS[i]);
+		int score = INT_MIN;
+		for (int l = 1; l <= lookahead; ++l) {
+			score = searcher.search(AI_EVALUATOR, board, rng, l);
+			total_moves += searcher.get_num_moves();
+			total_aborts += searcher.get_num_aborts();
+			total_wasted += searcher.get_num_wasted_moves();
+		}
+		scores[i] = score;
+		if (reference && reference[i] != score) { ++mismatches; }
+	}
+	const double elapsed = get_time() - start;
+	char label[64];
+	snprintf(label, sizeof(label), "ybwc, %d thread(s)", searcher.get_num_threads());
+	printf("%-32s %12lld moves %9.3fs  %lld aborts  %lld wasted moves", label, total_moves, elapsed, total_aborts, total_wasted);
+	if (reference) { printf("  (%d scores differ)", mismatches); }
+	printf("\n");
+}
+
+static int bench_star1_cuts(const Searcher &searcher) {
+	return static_cast<const SearcherStarExpectimax&>(searcher).get_num_star1_cuts();
+}
+
+static int bench_star2_cuts(const Searcher &searcher) {
+	return static_cast<const SearcherStarExpectimax&>(searcher).get_num_star2_cuts();
+}
+
+// Searches the bench positions like bench_searcher(), and prints the number of Star1 / Star2
+// cutoffs at each (chance node) lookahead
+static void bench_star_cuts(const char *name, SearcherStarExpectimax &searcher, int lookahead) {
+	enum { MAX_DEPTH = 20 };
+	long long star1[MAX_DEPTH] = {0};
+	long long star2[MAX_DEPTH] = {0};
+	RNG rng;
+	rng.reset();
+	for (int i = 0; i < NUM_BENCH_POSITIONS; ++i) {
+		Board board;
+		unpack_board_state(board, BENCH_POSITIONS[i]);
+		for (int l = 1; l <= lookahead; ++l) {
+			searcher.search(AI_EVALUATOR, board, rng, l);
+			for (int d = 1; d <= min(l*2, (int)MAX_DEPTH - 1); d += 2) {
+				star1[d] += searcher.get_num_star1_cuts(d);
+				star2[d] += searcher.get_num_star2_cuts(d);
+			}
+		}
+	}
+	printf("%-32s", name);
+	for (int d = min(lookahead*2, (int)MAX_DEPTH - 1) - 1; d >= 1; d -= 2) { printf(" %lld/%lld", star1[d], star2[d]); }
+	printf("\n");
+}
+
+// Searches the bench positions like bench_searcher(), and prints the number of alpha-beta cutoffs
+// at each lookahead (the number made by the first child searched / the total)
+static void bench_cutoffs(const char *name, SearcherCachingAlphaBeta &searcher, int lookahead) {
+	enum { MAX_DEPTH = 20 };
+	long long first[MAX_DEPTH] = {0};
+	long long total[MAX_DEPTH] = {0};
+	RNG rng;
+	rng.reset();
+	for (int i = 0; i < NUM_BENCH_POSITIONS; ++i) {
+		Board board;
+		unpack_board_state(board, BENCH_POSITIONS[i]);
+		for (int l = 1; l <= lookahead; ++l) {
+			searcher.search(AI_EVALUATOR, board, rng, l);
+			for (int d = 1; d <= min(l*2, (int)MAX_DEPTH - 1); ++d) {
+				first[d] += searcher.get_num_first_child_cutoffs(d);
+				total[d] += searcher.get_num_cutoffs(d);
+			}
+		}
+	}
+	printf("%-32s", name);
+	for (int d = min(lookahead*2, (int)MAX_DEPTH - 1); d >= 1; --d) { printf(" %lld/%lld", first[d], total[d]); }
+	printf("\n");
+}
+
+// Searches the bench positions like bench_searcher(), but suspends each search after every
+// slice nodes and resumes it, and prints the number of times the searches were suspended
+static void bench_suspended(const char *name, SearcherStackAlphaBeta &searcher, int lookahead, int slice,
+		const int *reference, int *scores) {
+	long long total_moves = 0;
+	long long total_suspends = 0;
+	int mismatches = 0;
+	const double start = get_time();
+	for (int i = 0; i < NUM_BENCH_POSITIONS; ++i) {
+		Board board;
+		unpack_board_state(board, BENCH_POSITIONS[i]);
+		for (int l = 1; l <= lookahead; ++l) {
+			searcher.start(AI_EVALUATOR, board, l);
+			while (!searcher.resume(slice)) {}
+			total_moves += searcher.get_num_moves();
+			total_suspends += searcher.get_num_suspends();
+		}
+		scores[i] = searcher.get_score();
+		if (reference && reference[i] != scores[i]) { ++mismatches; }
+	}
+	const double elapsed = get_time() - start;
+	printf("%-32s %12lld moves %9.3fs  %lld suspends", name, total_moves, elapsed, total_suspends);
+	if (reference) { printf("  (%d scores differ)", mismatches); }
+	printf("\n");
+}
+
+// Searches each bench position twice in a row with the same searcher (so the second search
+// starts with whatever the first one left behind), with search() to the given lookahead, or
+// with search_timed() if a time budget is given, and prints how many searches gave a legal move
+static void bench_repeat(const char *name, Searcher &searcher, int lookahead, double budget) {
+	RNG rng;
+	rng.reset();
+	int legal = 0;
+	int total = 0;
+	for (int i = 0; i < NUM_BENCH_POSITIONS; ++i) {
+		Board board;
+		unpack_board_state(board, BENCH_POSITIONS[i]);
+		for (int k = 0; k < 2; ++k) {
+			if (budget > 0.0) {
+				searcher.search_timed(AI_EVALUATOR, board, rng, AI_MAX_LOOKAHEAD, budget);
+			} else {
+				searcher.search(AI_EVALUATOR, board, rng, lookahead);
+			}
+			const int move = searcher.get_best_first_move();
+			if (move >= 0 && board.can_move(move)) { ++legal; }
+			++total;
+		}
+	}
+	printf("%-32s %d/%d legal moves\n", name, legal, total);
+}
+
+// expected score (by expectimax, to the given lookahead) of each move from each bench position
+// (-DBL_MAX for moves that aren't possible), and the best move from each position
+static void bench_move_scores(int lookahead, double (*scores)[4], int *best) {
+	SearcherExpectimax searcher;
+	RNG rng;
+	rng.reset();
+	for (int i = 0; i < NUM_BENCH_POSITIONS; ++i) {
+		Board board;
+		unpack_board_state(board, BENCH_POSITIONS[i]);
+		best[i] = -1;
+		for (int dir = 0; dir < 4; ++dir) {
+			Board next_state = board;
+			scores[i][dir] = -DBL_MAX;
+			if (!next_state.tilt(DIR_DX[dir], DIR_DY[dir])) { continue; }
+			scores[i][dir] = searcher.search_afterstate(AI_EVALUATOR, next_state, rng, lookahead);
+			if (best[i] < 0 || scores[i][dir] > scores[i][best[i]]) { best[i] = dir; }
+		}
+	}
+}
+
+// Searches each bench position with a time budget (in seconds), the way the AI does, and prints
+// the number of moves chosen that match the best moves, the average expected score lost by the
+// moves chosen (compared with the best moves), and the number of moves searched per millisecond
+static void bench_quality(const char *name, Searcher &searcher, double budget, double (*move_scores)[4], const int *best) {
+	RNG rng;
+	rng.reset();
+	int agree = 0;
+	double loss = 0.0;
+	long long total_moves = 0;
+	const double start = get_time();
+	for (int i = 0; i < NUM_BENCH_POSITIONS; ++i) {
+		Board board;
+		unpack_board_state(board, BENCH_POSITIONS[i]);
+		searcher.search_timed(AI_EVALUATOR, board, rng, AI_MAX_LOOKAHEAD, budget);
+		total_moves += searcher.get_num_moves();
+		const int move = searcher.get_best_first_move();
+		if (move == best[i]) { ++agree; }
+		// no move at all (out of time before the first iteration finished) counts as the worst move
+		double score = DBL_MAX;
+		for (int dir = 0; dir < 4; ++dir) {
+			if (move_scores[i][dir] > -DBL_MAX) { score = min(score, move_scores[i][dir]); }
+		}
+		if (move >= 0) { score = move_scores[i][move]; }
+		loss += move_scores[i][best[i]] - score;
+	}
+	const double elapsed = get_time() - start;
+	char label[64];
+	snprintf(label, sizeof(label), "%s %gms", name, budget * 1000.0);
+	printf("%-32s %2d/%d best moves  %7.3f average loss  %9.1f moves/ms\n",
+			label, agree, NUM_BENCH_POSITIONS, loss / NUM_BENCH_POSITIONS, total_moves / (elapsed * 1000.0));
+}
+
+// Searches the bench positions with the rollout searcher, like bench_searcher(), and prints the
+// number of games played and the number played per second; the moves chosen are stored in moves,
+// and if reference moves are given, the number of positions where they differ is printed too
+static void bench_rollouts(SearcherRollout &searcher, int lookahead, const int *reference, int *moves) {
+	RNG rng;
+	rng.reset();
+	long long total_playouts = 0;
+	int mismatches = 0;
+	const double start = get_time();
+	for (int i = 0; i < NUM_BENCH_POSITIONS; ++i) {
+		Board board;
+		unpack_board_state(board, BENCH_POSITIONS[i]);
+		for (int l = 1; l <= lookahead; ++l) {
+			searcher.search(AI_EVALUATOR, board, rng, l);
+			total_playouts += searcher.get_num_playouts();
+		}
+		moves[i] = searcher.get_best_first_move();
+		if (reference && reference[i] != moves[i]) { ++mismatches; }
+	}
+	const double elapsed = get_time() - start;
+	char label[64];
+	snprintf(label, sizeof(label), "rollouts, %d thread(s)", searcher.get_num_threads());
+	printf("%-32s %12lld games %9.3fs %12.0f games/s", label, total_playouts, elapsed, total_playouts / elapsed);
+	if (reference) { printf("  (%d moves differ)", mismatches); }
+	printf("\n");
+}
+
+// Searches the bench positions with expectimax, like bench_searcher(), but compares the moves
+// chosen rather than the scores (which always change with the probability cutoff); also prints
+// the number of subtrees the probability cutoff skipped
+static void bench_expectimax_moves(const char *name, SearcherExpectimax &searcher, int lookahead, const int *reference, int *moves) {
+	RNG rng;
+	rng.reset();
+	long long total_moves = 0;
+	long long total_cutoffs = 0;
+	int mismatches = 0;
+	const double start = get_time();
+	for (int i = 0; i < NUM_BENCH_POSITIONS; ++i) {
+		Board board;
+		unpack_board_state(board, BENCH_POSITIONS[i]);
+		for (int l = 1; l <= lookahead; ++l) {
+			searcher.search(AI_EVALUATOR, board, rng, l);
+			total_moves += searcher.get_num_moves();
+			total_cutoffs += searcher.get_num_cutoffs();
+		}
+		moves[i] = searcher.get_best_first_move();
+		if (reference && reference[i] != moves[i]) { ++mismatches; }
+	}
+	const double elapsed = get_time() - start;
+	printf("%-32s %12lld moves %9.3fs  %lld cutoffs", name, total_moves, elapsed, total_cutoffs);
+	if (reference) { printf("  (%d moves differ)", mismatches); }
+	printf("\n");
+}
+
+// Plays whole games (up to a move limit, from a few fixed seeds) with expectimax, searching each
+// position to the lookahead picked by the policy (or to a fixed lookahead, if there's no policy),
+// and prints the total search time, the average lookahead, and the total score
+static void bench_games(const char *name, DepthPolicyFn policy, int fixed_lookahead) {
+	enum { NUM_GAMES = 4, MAX_MOVES = 1000 };
+	SearcherExpectimax searcher;
+	long long total_score = 0;
+	long long total_lookahead = 0;
+	int total_moves = 0;
+	int games_lost = 0;
+	double elapsed = 0.0;
+	for (int game = 0; game < NUM_GAMES; ++game) {
+		RNG rng;
+		rng.reset(game + 1);
+		Board board;
+		board.reset();
+		board.place(2, 0, rng);
+		int score = 0;
+		int moves = 0;
+		for (; moves < MAX_MOVES; ++moves) {
+			const int lookahead = (policy ? policy(board) : fixed_lookahead);
+			const double start = get_time();
+			searcher.search(AI_EVALUATOR, board, rng, lookahead);
+			elapsed += get_time() - start;
+			total_lookahead += lookahead;
+			const int move = searcher.get_best_first_move();
+			if (move < 0) {
+				++games_lost;
+				break;
+			}
+			board.move(move, 0, rng, &score);
+		}
+		total_moves += moves;
+		total_score += score;
+	}
+	printf("%-32s %9.3fs  lookahead %.2f  %d moves  %d/%d games lost  score %lld\n",
+			name, elapsed, (double)total_lookahead / max(total_moves, 1), total_moves,
+			games_lost, NUM_GAMES, total_score);
+}
+
+// Plays the first moves of a game (from a fixed seed), like autoplay does: each move is
+// searched to the given lookahead, or if a time budget (in seconds) is given, with iterative
+// deepening up to AI_MAX_LOOKAHEAD. Prints the total number of moves searched, the total time,
+// the average lookahead reached, and the score.
+static void bench_autoplay(const char *name, Searcher &searcher, int lookahead, double budget) {
+	enum { NUM_MOVES = 200 };
+	RNG rng;
+	rng.reset(1);
+	Board board;
+	board.reset();
+	board.place(2, 0, rng);
+	long long total_moves = 0;
+	long long total_lookahead = 0;
+	int score = 0;
+	int moves = 0;
+	const double start = get_time();
+	for (; moves < NUM_MOVES; ++moves) {
+		if (budget > 0.0) {
+			searcher.search_timed(AI_EVALUATOR, board, rng, AI_MAX_LOOKAHEAD, budget);
+		} else {
+			searcher.search(AI_EVALUATOR, board, rng, lookahead);
+		}
+		total_moves += searcher.get_num_moves();
+		total_lookahead += searcher.get_completed_lookahead();
+		const int move = searcher.get_best_first_move();
+		if (move < 0) { break; }
+		board.move(move, 0, rng, &score);
+	}
+	const double elapsed = get_time() - start;
+	printf("%-32s %12lld moves %9.3fs  lookahead %.2f  score %d\n",
+			name, total_moves, elapsed, (double)total_lookahead / max(moves, 1), score);
+}
+
+// Runs without a window: compares searchers on the bench positions
+static int run_bench(int lookahead) {
+	int reference[NUM_BENCH_POSITIONS];
+	int scores[NUM_BENCH_POSITIONS];
+	printf("%d positions, lookahead %d\n", NUM_BENCH_POSITIONS, lookahead);
+	{
+		SearcherCachingAlphaBeta searcher;
+		bench_searcher("caching-alpha-beta", searcher, lookahead, 0, reference);
+	}
+	{
+		SearcherCachingAlphaBeta searcher;
+		searcher.set_pvs(true);
+		bench_searcher("caching-alpha-beta (pvs)", searcher, lookahead, reference, scores);
+	}
+	{
+		SearcherCachingAlphaBeta searcher;
+		searcher.set_mtdf(true);
+		bench_searcher("caching-alpha-beta (mtd(f))", searcher, lookahead, reference, scores,
+				&bench_mtdf_passes, "passes");
+	}
+	{
+		SearcherCachingAlphaBeta searcher;
+		searcher.set_aspiration(1, 4);
+		bench_searcher("caching-alpha-beta (aspiration)", searcher, lookahead, reference, scores,
+				&bench_aspiration_fails, "fails");
+	}
+
+	printf("max nodes cut off by probing the cache for their children:\n");
+	{
+		SearcherCachingAlphaBeta searcher;
+		searcher.set_transposition_cutoffs(false);
+		bench_searcher("no transposition cutoffs", searcher, lookahead, reference, scores);
+	}
+	{
+		SearcherCachingAlphaBeta searcher;
+		bench_searcher("transposition cutoffs", searcher, lookahead, reference, scores,
+				&bench_transposition_cutoffs, "cutoffs");
+	}
+	{
+		SearcherCachingAlphaBeta searcher;
+		searcher.set_mtdf(true);
+		bench_searcher("transposition cutoffs (mtd(f))", searcher, lookahead, reference, scores,
+				&bench_transposition_cutoffs, "cutoffs");
+	}
+
+	printf("max nodes where the first move tried was the best:\n");
+	{
+		SearcherCachingAlphaBeta searcher;
+		searcher.set_move_heuristics(false);
+		bench_searcher("no killer/history", searcher, lookahead, reference, scores,
+				&bench_first_moves_best, "first moves best", &bench_best_moves);
+	}
+	{
+		SearcherCachingAlphaBeta searcher;
+		bench_searcher("killer/history", searcher, lookahead, reference, scores,
+				&bench_first_moves_best, "first moves best", &bench_best_moves);
+	}
+
+	printf("cutoffs (by the first child / in total) at each lookahead, from the root down:\n");
+	{
+		SearcherCachingAlphaBeta searcher;
+		searcher.set_placement_order(SearcherCachingAlphaBeta::PLACEMENT_ORDER_CELLS);
+		bench_searcher("placements in cell order", searcher, lookahead, reference, scores);
+		bench_cutoffs("", searcher, lookahead);
+	}
+	{
+		SearcherCachingAlphaBeta searcher;
+		searcher.set_placement_order(SearcherCachingAlphaBeta::PLACEMENT_ORDER_EVAL);
+		bench_searcher("placements by evaluation", searcher, lookahead, reference, scores);
+		bench_cutoffs("", searcher, lookahead);
+	}
+	{
+		SearcherCachingAlphaBeta searcher;
+		searcher.set_placement_order(SearcherCachingAlphaBeta::PLACEMENT_ORDER_HISTORY);
+		bench_searcher("placements by history", searcher, lookahead, reference, scores);
+		bench_cutoffs("", searcher, lookahead);
+	}
+
+	printf("lazy smp (threads sharing one cache; the first to finish, maybe one ply deeper, wins):\n");
+	{
+		const int num_threads = (int)tthread::thread::hardware_concurrency();
+		for (int threads = 1; threads <= max(num_threads, 4); threads *= 2) {
+			SearcherLazySMP<SearcherCachingAlphaBeta> searcher(threads);
+			char label[64];
+			snprintf(label, sizeof(label), "lazy smp, %d thread(s)", threads);
+			bench_searcher(label, searcher, lookahead, reference, scores);
+		}
+	}
+
+	printf("root split (each first move searched on its own thread):\n");
+	{
+		SearcherCachingAlphaBeta serial;
+		const double serial_time = bench_searcher("serial", serial, lookahead, reference, scores);
+		SearcherRootSplit<SearcherCachingAlphaBeta> split;
+		const double split_time = bench_searcher("root split", split, lookahead, reference, scores);
+		printf("%-32s %.2fx\n", "speed-up over serial", serial_time / split_time);
+	}
+
+	printf("young brothers wait (nodes split into tasks once their first child is searched):\n");
+	{
+		SearcherCachingAlphaBeta serial;
+		bench_searcher("serial", serial, lookahead, reference, scores);
+		const int num_threads = (int)tthread::thread::hardware_concurrency();
+		for (int threads = 1; threads <= max(num_threads, 4); threads *= 2) {
+			SearcherParallel<SearcherCachingAlphaBeta> searcher(threads);
+			bench_ybwc(searcher, lookahead, reference, scores);
+		}
+	}
+
+	printf("each position searched twice by the same searcher:\n");
+	{
+		SearcherCachingAlphaBeta searcher;
+		bench_repeat("caching-alpha-beta", searcher, lookahead, 0.0);
+		bench_repeat("caching-alpha-beta, 10ms", searcher, 0, 0.01);
+	}
+	{
+		SearcherLazySMP<SearcherCachingAlphaBeta> searcher;
+		bench_repeat("lazy smp", searcher, lookahead, 0.0);
+		bench_repeat("lazy smp, 10ms", searcher, 0, 0.01);
+	}
+	{
+		SearcherParallel<SearcherCachingAlphaBeta> searcher;
+		bench_repeat("ybwc", searcher, lookahead, 0.0);
+		bench_repeat("ybwc, 1ms", searcher, 0, 0.001);
+	}
+
+	printf("alpha-beta without caching, recursive or with an explicit stack:\n");
+	{
+		int ab_reference[NUM_BENCH_POSITIONS];
+		SearcherAlphaBeta copying;
+		copying.set_make_unmake(false);
+		bench_searcher("recursive, copying boards", copying, lookahead, 0, ab_reference,
+				&bench_board_kib, "KiB of board traffic (estimate)");
+		SearcherAlphaBeta recursive;
+		bench_searcher("recursive, make/unmake", recursive, lookahead, ab_reference, scores,
+				&bench_board_kib, "KiB of board traffic (estimate)");
+		SearcherStackAlphaBeta stack;
+		bench_searcher("explicit stack, make/unmake", stack, lookahead, ab_reference, scores);
+		bench_suspended("explicit stack, 1000-node slices", stack, lookahead, 1000, ab_reference, scores);
+	}
+
+	printf("expectimax with and without the probability cutoff:\n");
+	{
+		int reference_moves[NUM_BENCH_POSITIONS];
+		int moves[NUM_BENCH_POSITIONS];
+		SearcherExpectimax full;
+		full.set_probability_cutoff(0.0f);
+		bench_expectimax_moves("expectimax, no cutoff", full, lookahead, 0, reference_moves);
+		SearcherExpectimax cutoff;
+		bench_expectimax_moves("expectimax, default cutoff", cutoff, lookahead, reference_moves, moves);
+	}
+
+	printf("task-parallel expectimax at the lookaheads the AI plays with:\n");
+	for (int l = 2; l <= 3; ++l) {
+		int ex_reference[NUM_BENCH_POSITIONS];
+		char label[64];
+		// (setting up the caches isn't part of the search)
+		SearcherExpectimax serial;
+		serial.prepare(AI_EVALUATOR);
+		snprintf(label, sizeof(label), "serial, lookahead %d", l);
+		const double serial_time = bench_searcher(label, serial, l, 0, ex_reference);
+		SearcherParallel<SearcherExpectimax> parallel;
+		parallel.prepare(AI_EVALUATOR);
+		snprintf(label, sizeof(label), "%d thread(s), lookahead %d", parallel.get_num_threads(), l);
+		const double parallel_time = bench_searcher(label, parallel, l, ex_reference, scores);
+		printf("%-32s %.2fx\n", "speed-up over serial", serial_time / parallel_time);
+	}
+
+	printf("expectimax with Star1 / Star2 pruning (star1/star2 cutoffs at each chance node lookahead):\n");
+	{
+		int ex_reference[NUM_BENCH_POSITIONS];
+		SearcherExpectimax expectimax;
+		expectimax.set_probability_cutoff(0.0f);
+		bench_searcher("expectimax, no probability cutoff", expectimax, lookahead, 0, ex_reference);
+		SearcherStarExpectimax star1;
+		bench_searcher("star1", star1, lookahead, ex_reference, scores, &bench_star1_cuts, "star1 cutoffs");
+		bench_star_cuts("", star1, lookahead);
+		SearcherStarExpectimax star2;
+		star2.set_probing(true);
+		bench_searcher("star2", star2, lookahead, ex_reference, scores, &bench_star2_cuts, "star2 cutoffs");
+		bench_star_cuts("", star2, lookahead);
+	}
+
+	printf("whole games with expectimax (at most 1000 moves each):\n");
+	bench_games("fixed lookahead 2", 0, 2);
+	bench_games("fixed lookahead 3", 0, 3);
+	bench_games("adaptive lookahead", &ai_depth_policy, 0);
+
+	printf("first 200 moves of a game, keeping the work done for the last move or not:\n");
+	{
+		SearcherExpectimax fresh;
+		fresh.set_keep_cache(false);
+		bench_autoplay("expectimax, fresh cache", fresh, 3, 0.0);
+		SearcherExpectimax kept;
+		bench_autoplay("expectimax, kept cache", kept, 3, 0.0);
+	}
+	{
+		SearcherExpectimax fresh;
+		fresh.set_keep_cache(false);
+		bench_autoplay("expectimax, fresh cache, 10ms", fresh, 0, 0.01);
+		SearcherExpectimax kept;
+		bench_autoplay("expectimax, kept cache, 10ms", kept, 0, 0.01);
+	}
+	{
+		SearcherMCTS fresh;
+		fresh.set_tree_reuse(false);
+		bench_autoplay("mcts, fresh tree", fresh, 4, 0.0);
+		SearcherMCTS kept;
+		bench_autoplay("mcts, kept subtree", kept, 4, 0.0);
+	}
+
+	printf("random games played to the end from each move:\n");
+	{
+		int reference_moves[NUM_BENCH_POSITIONS];
+		int moves[NUM_BENCH_POSITIONS];
+		SearcherRollout serial(1);
+		bench_rollouts(serial, lookahead, 0, reference_moves);
+		const int num_threads = (int)tthread::thread::hardware_concurrency();
+		for (int threads = 2; threads <= max(num_threads, 4); threads *= 2) {
+			SearcherRollout parallel(threads);
+			bench_rollouts(parallel, lookahead, reference_moves, moves);
+		}
+	}
+
+	printf("search quality for a time budget, compared with expectimax with lookahead %d:\n", lookahead);
+	{
+		static double move_scores[NUM_BENCH_POSITIONS][4];
+		int best[NUM_BENCH_POSITIONS];
+		bench_move_scores(lookahead, move_scores, best);
+		static const double BUDGETS[] = { 0.001, 0.002, 0.005, 0.01, 0.02, 0.05 };
+		for (int i = 0; i < (int)(sizeof(BUDGETS) / sizeof(BUDGETS[0])); ++i) {
+			SearcherExpectimax expectimax;
+			bench_quality("expectimax", expectimax, BUDGETS[i], move_scores, best);
+			SearcherMCTS mcts;
+			bench_quality("mcts", mcts, BUDGETS[i], move_scores, best);
+			SearcherRollout rollouts;
+			bench_quality("rollouts", rollouts, BUDGETS[i], move_scores, best);
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+		const int lookahead = (argc > 2 ? atoi(argv[2]) : 4);
+		return run_bench(max(lookahead, 1));
+	}
+
 	glfwInit();
 	glfwWindowHint(GLFW_SAMPLES, 8);
 	glfwWindowHint(GLFW_DEPTH_BITS, 0);
@@ -1842,6 +5351,7 @@ int main(int /*argc*/, char** /*argv*/) {
 	prime_fontstash_cache(wnd);
 
 	s_ai_worker = new AIWorker();
+	s_ai_worker->SetDepthPolicy(&ai_depth_policy);
 
 	s_autoplay = false;
 	s_anim.reset();
@@ -1864,6 +5374,7 @@ int main(int /*argc*/, char** /*argv*/) {
 	s_history.new_game(s_anim);
 	start_anim(ANIM_SPEED_NORMAL);
 #endif
+	ponder();
 
 	glfwSetKeyCallback(wnd, &handle_key);
 
@@ -1894,6 +5405,8 @@ int main(int /*argc*/, char** /*argv*/) {
 						// when autoplaying, overlap computation of the
 						// next move with animation of the last move
 						automove();
+					} else {
+						ponder();
 					}
 				}
 			}
@@ -1907,6 +5420,8 @@ int main(int /*argc*/, char** /*argv*/) {
 			glfwPollEvents();
 		}
 	}
+	delete s_ai_worker;
+	s_ai_worker = 0;
 	glfwTerminate();
 	return 0;
 }